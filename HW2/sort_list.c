@@ -8,12 +8,22 @@
 #include <math.h>
 #include <time.h>
 #include <limits.h>
+#include <unistd.h>
+
+#include "../common/list_init.h"
+#include "../common/list_check.h"
+#include "../common/bench_stats.h"
 
 #define MAX_THREADS     65536
 #define MAX_LIST_SIZE   268435460
 
 #define DEBUG 0
 
+// Verification of the sorted list
+#define CHECK_NONE	0	// no verification
+#define CHECK_FAST	1	// parallel sortedness check + key fingerprint
+#define CHECK_FULL	2	// compare with list_orig sorted by qsort
+
 // Thread variables
 //
 // VS: ... declare thread variables, mutexes, condition varables, etc.,
@@ -24,11 +34,28 @@ typedef struct Thread_data{
     int index;
 }thread_data;
 
+typedef struct Check_data{
+    int index;
+    int check_order;		// Check sortedness (1) or fingerprint only (0)
+    int error;			// Set if sub-list is not sorted
+    list_fingerprint fingerprint;	// Fingerprint of sub-list
+}check_data;
+
 pthread_t p_threads[MAX_THREADS];
 pthread_cond_t cond_copy, cond_next, cond_start;
 pthread_mutex_t lock_copy, lock_next, lock_start;
 int copy_count = 0, next_count = 0, start_count = 0;
 
+// Sort thread pool: the sort threads are created once per thread count and
+// wait for the next run, so thread creation is not part of the sort time
+pthread_t pool_threads[MAX_THREADS];
+thread_data pool_data[MAX_THREADS];
+pthread_cond_t cond_pool_run, cond_pool_done;
+pthread_mutex_t lock_pool;
+int pool_run = 0;		// Number of runs started
+int pool_done = 0;		// Threads done with the current run
+int pool_quit = 0;		// Set to terminate the pool threads
+
 
 // Global variables
 int num_threads;		// Number of threads to create - user input 
@@ -115,6 +142,44 @@ int binary_search_le(int v, int *list, int first, int last) {
     return right;
 }
 
+// Compute fingerprint of a thread's sub-list and check that it is sorted
+//
+void* check_list_parallel(void* data) {
+    check_data* my_data = (check_data*)data;
+    int my_segment_size = list_size / num_threads;
+    int my_first = my_data->index * my_segment_size;
+    int my_last = my_first + my_segment_size;
+
+    my_data->fingerprint = fingerprint_range(list, my_first, my_last);
+    my_data->error = 0;
+    if (my_data->check_order) {
+	my_data->error = unsorted_range(list, my_first, my_last, list_size);
+    }
+    return NULL;
+}
+
+// Fingerprint of list computed by num_threads threads; if check_order is
+// set, *error is set to 1 if list is not in ascending order
+//
+list_fingerprint check_list(int check_order, int *error) {
+    check_data check_data_array[num_threads];
+    list_fingerprint fingerprint = {0, 0};
+    int i;
+
+    for (i = 0; i < num_threads; i++) {
+	check_data_array[i].index = i;
+	check_data_array[i].check_order = check_order;
+	pthread_create(&p_threads[i], NULL, check_list_parallel, &check_data_array[i]);
+    }
+    *error = 0;
+    for (i = 0; i < num_threads; i++) {
+	pthread_join(p_threads[i], NULL);
+	fingerprint = fingerprint_combine(fingerprint, check_data_array[i].fingerprint);
+	*error |= check_data_array[i].error;
+    }
+    return fingerprint;
+}
+
 // Sort list via parallel merge sort
 //
 // VS: ... to be parallelized using threads ...
@@ -204,6 +269,71 @@ void* sort_list_parallel(void* data) {
     return NULL;
 }
 
+// Sort pool thread: run sort_list_parallel once per run started by 
+// run_sort_pool, until stop_sort_pool is called
+void* sort_pool_thread(void* data) {
+    int my_run = 0;
+
+    pthread_mutex_lock(&lock_pool);
+    while (1) {
+        while ((pool_run == my_run) && !pool_quit) {
+            pthread_cond_wait(&cond_pool_run, &lock_pool);
+        }
+        if (pool_quit) break;
+        my_run = pool_run;
+        pthread_mutex_unlock(&lock_pool);
+
+        sort_list_parallel(data);
+
+        pthread_mutex_lock(&lock_pool);
+        pool_done++;
+        if (pool_done == num_threads) {
+            pthread_cond_signal(&cond_pool_done);
+        }
+    }
+    pthread_mutex_unlock(&lock_pool);
+
+    return NULL;
+}
+
+// Create num_threads = 2^q sort threads
+void start_sort_pool(int q) {
+    int i;
+
+    pool_run = 0;
+    pool_quit = 0;
+    for (i = 0; i < num_threads; i++) {
+        pool_data[i].index = i;
+        pool_data[i].q = q;
+        pthread_create(&pool_threads[i], NULL, sort_pool_thread, &pool_data[i]);
+    }
+}
+
+// Sort list with the pool threads; returns when all threads are done
+void run_sort_pool() {
+    pthread_mutex_lock(&lock_pool);
+    pool_done = 0;
+    pool_run++;
+    pthread_cond_broadcast(&cond_pool_run);
+    while (pool_done < num_threads) {
+        pthread_cond_wait(&cond_pool_done, &lock_pool);
+    }
+    pthread_mutex_unlock(&lock_pool);
+}
+
+// Terminate and join the sort threads
+void stop_sort_pool() {
+    int i;
+
+    pthread_mutex_lock(&lock_pool);
+    pool_quit = 1;
+    pthread_cond_broadcast(&cond_pool_run);
+    pthread_mutex_unlock(&lock_pool);
+    for (i = 0; i < num_threads; i++) {
+        pthread_join(pool_threads[i], NULL);
+    }
+}
+
 
 
 void sort_list(int q) {
@@ -291,31 +421,154 @@ if (DEBUG) print_list(list, list_size);
     }
 }
 
+// Initialize list, sort it with the num_threads sort pool threads and check
+// the result; the sort time covers the sort only, not thread creation
+// Input:
+//	dist	- input distribution, -1 for lrand48 values
+//	check	- verification mode
+// Output:
+//	*sort_time, *check_time - time taken by sort and by verification
+//	returns error (0 if list has been sorted correctly)
+//
+int sort_and_check(int dist, int check, double *sort_time, double *check_time) {
+
+    struct timespec start, stop, stop_check;
+    list_fingerprint fingerprint_orig = {0, 0};
+    int j, error; 
+
+    // Initialize list of random integers; list will be sorted by 
+    // multi-threaded parallel merge sort
+    if (dist >= 0) {
+	fill_list_int(list, list_size, 0, list_size, num_threads, dist, 0);
+    } else {
+	srand48(0); 	// seed the random number generator
+	for (j = 0; j < list_size; j++) {
+	    list[j] = (int) lrand48();
+	}
+	// duplicate first value at last location to test for repeated values
+	list[list_size-1] = list[0];
+    }
+    // Full check: copy list to list_orig; list_orig will be sorted by qsort 
+    // and used to check correctness of multi-threaded parallel merge sort
+    // Fast check: fingerprint of list is compared with that of sorted list
+    if (check == CHECK_FULL) {
+	for (j = 0; j < list_size; j++) {
+	    list_orig[j] = list[j];
+	}
+    } else if (check == CHECK_FAST) {
+	fingerprint_orig = check_list(0, &error);
+    }
+
+    // Start the sort threads; each thread executes sort_list_parallel
+    clock_gettime(CLOCK_REALTIME, &start);
+
+    run_sort_pool();
+    // print_list(list, list_size);
+    // sort_list(q);
+
+    // Compute time taken
+    clock_gettime(CLOCK_REALTIME, &stop);
+    *sort_time = (stop.tv_sec-start.tv_sec)
+	+0.000000001*(stop.tv_nsec-start.tv_nsec);
+
+    // Check answer
+    error = 0; 
+    if (check == CHECK_FULL) {
+	qsort(list_orig, list_size, sizeof(int), compare_int);
+	// print_list(list_orig, list_size);
+	for (j = 0; j < list_size; j++) {
+	    if (list[j] != list_orig[j]) error = 1; 
+	}
+    } else if (check == CHECK_FAST) {
+	if (!fingerprint_equal(check_list(1, &error), fingerprint_orig)) error = 1;
+    }
+    clock_gettime(CLOCK_REALTIME, &stop_check);
+    *check_time = (stop_check.tv_sec-stop.tv_sec)
+	+0.000000001*(stop_check.tv_nsec-stop.tv_nsec);
+
+    return error;
+}
+
 // Main program - set up list of random integers and use threads to sort the list
 //
 // Input: 
 //	k = log_2(list size), therefore list_size = 2^k
 //	q = log_2(num_threads), therefore num_threads = 2^q
+// Options:
+//	-d <distribution>	initialize list with one of the distributions in
+//				../common/list_init.h (default: lrand48 values
+//				with the first value duplicated at the end)
+//	-c none|fast|full	verification of the sorted list: none, parallel
+//				sortedness + fingerprint check (default), or
+//				comparison with list sorted by qsort
+//	-r <repetitions>	benchmark mode: sort the list <repetitions> times
+//				in this process, reusing all allocations, and 
+//				report median/p10/p90 time and throughput;
+//				the sort threads are created once per thread
+//				count, outside the timed region
+//	-w <warmup>		benchmark mode: untimed runs before timed ones
+//				(default 2)
+//	-s <q_last>		benchmark mode: sweep q, q+1, ..., q_last
 //
 int main(int argc, char *argv[]) {
 
-    struct timespec start, stop, stop_qsort;
-    double total_time, time_res, total_time_qsort;
-    int k, q, j, error, i; 
+    double total_time, total_time_check;
+    int k, q, error, i; 
+    int dist = -1;		// Input distribution; -1 for lrand48 values
+    int check = CHECK_FAST;	// Verification mode
+    const char *check_names[] = {"none", "fast", "full"};
+    int reps = 0;		// Benchmark repetitions; 0 for a single run
+    int warmup = 2;		// Benchmark warmup runs
+    int q_last = -1;		// Last q of benchmark sweep
+    double *times;		// Benchmark timings
+    double median, p10, p90;
+    int opt;
 
     // Read input, validate
-    if (argc != 3) {
+    while ((opt = getopt(argc, argv, "d:c:r:w:s:")) != -1) {
+	switch (opt) {
+	    case 'd':
+		if ((dist = dist_from_name(optarg)) < 0) {
+		    printf("Unknown distribution: %s. Use one of: ", optarg);
+		    print_dist_names();
+		    exit(0);
+		}
+		break;
+	    case 'c':
+		for (check = CHECK_FULL; check >= 0; check--) {
+		    if (strcmp(optarg, check_names[check]) == 0) break;
+		}
+		if (check < 0) {
+		    printf("Unknown verification mode: %s. Use one of: none|fast|full\n", optarg);
+		    exit(0);
+		}
+		break;
+	    case 'r':
+		reps = atoi(optarg);
+		break;
+	    case 'w':
+		warmup = atoi(optarg);
+		break;
+	    case 's':
+		q_last = atoi(optarg);
+		break;
+	    default:
+		exit(0);
+	}
+    }
+    if (argc-optind != 2) {
 	printf("Need two integers as input \n"); 
-	printf("Use: <executable_name> <log_2(list_size)> <log_2(num_threads)>\n"); 
+	printf("Use: <executable_name> [-d distribution] [-c none|fast|full] [-r repetitions [-w warmup] [-s q_last]] <log_2(list_size)> <log_2(num_threads)>\n"); 
 	exit(0);
     }
-    k = atoi(argv[argc-2]);
+    k = atoi(argv[optind]);
     if ((list_size = (1 << k)) > MAX_LIST_SIZE) {
 	printf("Maximum list size allowed: %d.\n", MAX_LIST_SIZE);
 	exit(0);
     }; 
-    q = atoi(argv[argc-1]);
-    if ((num_threads = (1 << q)) > MAX_THREADS) {
+    q = atoi(argv[optind+1]);
+    if (q_last < q) q_last = q;
+    if ((num_threads = (1 << q_last)) > MAX_THREADS) {
 	printf("Maximum number of threads allowed: %d.\n", MAX_THREADS);
 	exit(0);
     }; 
@@ -324,95 +577,75 @@ int main(int argc, char *argv[]) {
 	   num_threads, list_size);
 	exit(0);
     }; 
+    if ((reps < 0) || (warmup < 0)) {
+	printf("Number of repetitions and warmup runs must be non-negative.\n");
+	exit(0);
+    }
 
-    // Allocate list, list_orig, and work
+    // Allocate list, list_orig (only needed for full verification), and work
 
     list = (int *) malloc(list_size * sizeof(int));
-    list_orig = (int *) malloc(list_size * sizeof(int));
+    list_orig = (check == CHECK_FULL) ? (int *) malloc(list_size * sizeof(int)) : NULL;
     work = (int *) malloc(list_size * sizeof(int));
 
-//
-// VS: ... May need to initialize mutexes, condition variables, 
-// VS: ... and their attributes
-//
-
-    // Initialize list of random integers; list will be sorted by 
-    // multi-threaded parallel merge sort
-    // Copy list to list_orig; list_orig will be sorted by qsort and used
-    // to check correctness of multi-threaded parallel merge sort
-    srand48(0); 	// seed the random number generator
-    for (j = 0; j < list_size; j++) {
-	list[j] = (int) lrand48();
-	list_orig[j] = list[j];
-    }
-    // duplicate first value at last location to test for repeated values
-    list[list_size-1] = list[0]; list_orig[list_size-1] = list_orig[0];
-
-    // Create threads; each thread executes find_minimum
-    clock_gettime(CLOCK_REALTIME, &start);
-
-//
-// VS: ... may need to initialize mutexes, condition variables, and their attributes
-//
-
-// Serial merge sort 
-// VS: ... replace this call with multi-threaded parallel routine for merge sort
-// VS: ... need to create threads and execute thread routine that implements 
-// VS: ... parallel merge sort
-    thread_data thread_data_array[num_threads];
-
     pthread_mutex_init(&lock_copy, NULL);
     pthread_mutex_init(&lock_next, NULL);
     pthread_mutex_init(&lock_start, NULL);
     pthread_cond_init(&cond_copy, NULL);
     pthread_cond_init(&cond_next, NULL);
     pthread_cond_init(&cond_start, NULL);
+    pthread_mutex_init(&lock_pool, NULL);
+    pthread_cond_init(&cond_pool_run, NULL);
+    pthread_cond_init(&cond_pool_done, NULL);
+
+    if (reps == 0) {
+	num_threads = 1 << q;
+	start_sort_pool(q);
+	error = sort_and_check(dist, check, &total_time, &total_time_check);
+	stop_sort_pool();
+
+	if (error != 0) {
+	    printf("Houston, we have a problem!\n"); 
+	}
 
-    for(i = 0; i < num_threads; i++){
-        (thread_data_array[i]).index = i;
-        (thread_data_array[i]).q = q;
-        pthread_create(&p_threads[i], NULL, sort_list_parallel, &thread_data_array[i]);
-    }
-
-    for(i = 0; i < num_threads; i ++){
-        pthread_join(p_threads[i], NULL);
-    }
-    // print_list(list, list_size);
-    // sort_list(q);
-
-    // Compute time taken
-    clock_gettime(CLOCK_REALTIME, &stop);
-    total_time = (stop.tv_sec-start.tv_sec)
-	+0.000000001*(stop.tv_nsec-start.tv_nsec);
-
-    // Check answer
-    qsort(list_orig, list_size, sizeof(int), compare_int);
-    clock_gettime(CLOCK_REALTIME, &stop_qsort);
-    total_time_qsort = (stop_qsort.tv_sec-stop.tv_sec)
-	+0.000000001*(stop_qsort.tv_nsec-stop.tv_nsec);
-    // print_list(list_orig, list_size);
-    error = 0; 
-    for (j = 1; j < list_size; j++) {
-	if (list[j] != list_orig[j]) error = 1; 
-    }
-
-    if (error != 0) {
-	printf("Houston, we have a problem!\n"); 
+	// Print time taken
+	printf("List Size = %d, Threads = %d, Distribution = %s, error = %d, time (sec) = %8.4f, check (%s) time = %8.4f\n", 
+		list_size, num_threads, (dist >= 0) ? dist_names[dist] : "lrand48",
+		error, total_time, check_names[check], total_time_check);
+    } else {
+	// Benchmark: list, work and list_orig are reused by all runs, and the
+	// list is re-initialized before each run (not timed)
+	times = (double *) malloc(reps * sizeof(double));
+	for (; q <= q_last; q++) {
+	    num_threads = 1 << q;
+	    error = 0;
+	    start_sort_pool(q);
+	    for (i = 0; i < warmup+reps; i++) {
+		error |= sort_and_check(dist, check, &total_time, &total_time_check);
+		if (i >= warmup) times[i-warmup] = total_time;
+	    }
+	    stop_sort_pool();
+	    if (error != 0) {
+		printf("Houston, we have a problem!\n"); 
+	    }
+	    bench_stats(times, reps, &median, &p10, &p90);
+	    printf("List Size = %d, Threads = %d, Distribution = %s, error = %d, repetitions = %d, time (sec) = %8.4f, p10 = %8.4f, p90 = %8.4f, throughput (elements/s) = %10.4e\n", 
+		    list_size, num_threads, (dist >= 0) ? dist_names[dist] : "lrand48",
+		    error, reps, median, p10, p90, list_size / median);
+	}
+	free(times);
     }
-    
-    // Print time taken
-    printf("List Size = %d, Threads = %d, error = %d, time (sec) = %8.4f, qsort_time = %8.4f\n", 
-	    list_size, num_threads, error, total_time, total_time_qsort);
 
-// VS: ... destroy mutex, condition variables, etc.
     pthread_mutex_destroy(&lock_copy);
     pthread_mutex_destroy(&lock_next);
     pthread_mutex_destroy(&lock_start);
     pthread_cond_destroy(&cond_copy);
     pthread_cond_destroy(&cond_next);
     pthread_cond_destroy(&cond_start);
+    pthread_mutex_destroy(&lock_pool);
+    pthread_cond_destroy(&cond_pool_run);
+    pthread_cond_destroy(&cond_pool_done);
 
-    free(list); free(work); free(list_orig); 
+    free(list); free(work); if (list_orig != NULL) free(list_orig); 
 
 }
- 
@@ -7,18 +7,41 @@
 #include <math.h>
 #include <time.h>
 #include <limits.h>
+#include <unistd.h>
+
+#include "../common/list_init.h"
+#include "../common/list_check.h"
+#include "../common/bench_stats.h"
 
 #define MAX_THREADS     65536
 #define MAX_LIST_SIZE   INT_MAX
 
 #define DEBUG 0
 
+// Verification of the sorted list
+#define CHECK_NONE      0       // no verification
+#define CHECK_FAST      1       // parallel sortedness check + key fingerprint
+#define CHECK_FULL      2       // compare with list_orig sorted by qsort
+
+// Sort algorithm
+#define SORT_MERGE      0       // 2^q sub-lists merged level by level
+#define SORT_TASKS      1       // recursive task-parallel merge sort
+#define SORT_BLOCKS     2       // 2^q sub-lists merged level by level by a
+                                // fixed team in one parallel region
+
+// Task-parallel merge sort: sub-lists with at most TASK_CUTOFF elements are
+// sorted with qsort, merges of at most TASK_CUTOFF elements are not split
+#define TASK_CUTOFF     8192
+
 // Global variables
 int num_threads;		// Number of threads to create - user input 
 int list_size;			// List size
 int *list;			// List of values
 int *work;			// Work array
 int *list_orig;			// Original list of values, used for error checking
+int sort_mode;			// Sort algorithm - user input
+int team;			// Number of OpenMP threads - user input (0 for
+				// default)
 
 // Print list - for debugging
 void print_list(int *list, int list_size) {
@@ -98,6 +121,29 @@ int binary_search_le(int v, int *list, int first, int last) {
     return right;
 }
 
+// Fingerprint of list computed in parallel; if check_order is set, *error
+// is set to 1 if list is not in ascending order
+//
+list_fingerprint check_list(int check_order, int *error) {
+    unsigned long long sum = 0, xor_ = 0;
+    int my_id, my_error = 0;
+    int np = list_size / num_threads;
+
+    #pragma omp parallel for reduction(+:sum) reduction(^:xor_) reduction(|:my_error) schedule(static)
+    for (my_id = 0; my_id < num_threads; my_id++) {
+        list_fingerprint f = fingerprint_range(list, my_id * np, (my_id + 1) * np);
+        sum += f.sum;
+        xor_ ^= f.xor_;
+        if (check_order) {
+            my_error |= unsorted_range(list, my_id * np, (my_id + 1) * np, list_size);
+        }
+    }
+
+    list_fingerprint fingerprint = {sum, xor_};
+    *error = my_error;
+    return fingerprint;
+}
+
 // Sort list via parallel merge sort
 //
 void sort_list(int q) {
@@ -192,31 +238,403 @@ void sort_list(int q) {
     }
 }
 
+// Merge sub-list my_id of src with the sorted sub-list it is paired with at
+// this level, writing to dst; this is one iteration of the scatter loop 
+// of sort_list()
+//
+void merge_block(int my_id, int level, int np, int *src, int *dst) {
+
+    int i;
+    int my_own_blk, my_own_idx;
+    int my_blk_size, my_search_blk, my_search_idx, my_search_idx_max;
+    int my_write_blk, my_write_idx;
+    int my_search_count; 
+    int idx, i_write; 
+    int my_first = my_id * np, my_last = my_first + np;
+
+    my_blk_size = np * (1 << level);
+
+    my_own_blk = ((my_id >> level) << level);
+    my_own_idx = my_own_blk * np;
+
+    my_search_blk = ((my_id >> level) << level) ^ (1 << level);
+    my_search_idx = my_search_blk * np;
+    my_search_idx_max = my_search_idx + my_blk_size;
+
+    my_write_blk = ((my_id >> (level + 1)) << (level + 1));
+    my_write_idx = my_write_blk * np;
+
+    // Binary search for 1st element
+    if (my_search_blk > my_own_blk) {
+        idx = binary_search_lt(src[my_first], src, my_search_idx, my_search_idx_max);
+    } else {
+        idx = binary_search_le(src[my_first], src, my_search_idx, my_search_idx_max);
+    }
+    my_search_count = idx - my_search_idx;
+    i_write = my_write_idx + my_search_count + (my_first - my_own_idx);
+    dst[i_write] = src[my_first];
+
+    // Linear search for 2nd element onwards
+    for (i = my_first + 1; i < my_last; i++) {
+        if (my_search_blk > my_own_blk) {
+            while ((idx < my_search_idx_max) && (src[i] > src[idx])) {
+                idx++; 
+                my_search_count++;
+            }
+        } else {
+            while ((idx < my_search_idx_max) && (src[i] >= src[idx])) {
+                idx++; 
+                my_search_count++;
+            }
+        }
+        i_write = my_write_idx + my_search_count + (i - my_own_idx);
+        dst[i_write] = src[i];
+    }
+}
+
+// Sort list via parallel merge sort of num_threads = 2^q sub-lists 
+// ("blocks") by a fixed team of OpenMP threads in one parallel region
+//
+// Each thread owns a contiguous range of blocks. There are no team barriers:
+// at a level, a block waits only until all blocks it merges with (and 
+// whose destination range it writes to) have finished the previous level.
+// This is tracked by one counter per group of 2^(level+1) blocks in ready[].
+// list and work are used alternately as source and destination, so no copy
+// pass is needed; list and work are swapped at the end if q is odd.
+//
+void sort_list_blocks(int q) {
+
+    int np = list_size / num_threads;	// Sub list size 
+    int *ready = (int *) calloc(num_threads, sizeof(int));
+    int *tmp;
+
+    #pragma omp parallel
+    {
+        int my_thread = omp_get_thread_num();
+        int my_team = omp_get_num_threads();
+        int my_first_blk = (int) ((long long) num_threads * my_thread / my_team);
+        int my_last_blk = (int) ((long long) num_threads * (my_thread + 1) / my_team);
+        int my_id, level, count, offset, next_offset;
+
+        // Sort local lists
+        for (my_id = my_first_blk; my_id < my_last_blk; my_id++) {
+            qsort(&list[my_id * np], np, sizeof(int), compare_int);
+            if (q > 0) {
+                #pragma omp flush
+                #pragma omp atomic update
+                ready[my_id >> 1]++;
+            }
+        }
+
+        // Counters of a level start at ready[offset], one per group of 
+        // 2^(level+1) blocks
+        offset = 0;
+        for (level = 0; level < q; level++) {
+            next_offset = offset + (num_threads >> (level + 1));
+            for (my_id = my_first_blk; my_id < my_last_blk; my_id++) {
+                // Wait for all blocks of this group to finish previous level
+                do {
+                    #pragma omp atomic read
+                    count = ready[offset + (my_id >> (level + 1))];
+                } while (count < (1 << (level + 1)));
+                #pragma omp flush
+
+                if (level % 2 == 0) {
+                    merge_block(my_id, level, np, list, work);
+                } else {
+                    merge_block(my_id, level, np, work, list);
+                }
+
+                if (level + 1 < q) {
+                    #pragma omp flush
+                    #pragma omp atomic update
+                    ready[next_offset + (my_id >> (level + 2))]++;
+                }
+            }
+            offset = next_offset;
+        }
+    }
+
+    if (q % 2 == 1) {
+        tmp = list; list = work; work = tmp;
+    }
+    free(ready);
+
+    if (DEBUG) print_list(list, list_size);
+}
+
+// Co-rank of output position k in the merge of sorted lists a[0 ... m-1] 
+// and b[0 ... n-1]: returns i such that the first k elements of the merged
+// list are a[0 ... i-1] and b[0 ... k-i-1] (elements of a come first on ties)
+//
+int co_rank(int k, int *a, int m, int *b, int n) {
+    int lo = (k > n) ? k - n : 0;
+    int hi = (k < m) ? k : m;
+    int mid;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (a[mid] <= b[k - mid - 1]) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Merge sorted lists a[0 ... m-1] and b[0 ... n-1] into out
+//
+void merge_serial(int *a, int m, int *b, int n, int *out) {
+    int i = 0, j = 0, k = 0;
+    while ((i < m) && (j < n)) {
+        if (a[i] <= b[j]) {
+            out[k++] = a[i++];
+        } else {
+            out[k++] = b[j++];
+        }
+    }
+    while (i < m) out[k++] = a[i++];
+    while (j < n) out[k++] = b[j++];
+}
+
+// Merge sorted lists a[0 ... m-1] and b[0 ... n-1] into out; the merge is 
+// split in two halves of the output via co_rank, each merged by a task
+//
+void merge_tasks(int *a, int m, int *b, int n, int *out) {
+    int k, i;
+    if (m + n <= TASK_CUTOFF) {
+        merge_serial(a, m, b, n, out);
+        return;
+    }
+    k = (m + n) / 2;
+    i = co_rank(k, a, m, b, n);
+
+    #pragma omp task
+    merge_tasks(a, i, b, k - i, out);
+    #pragma omp task
+    merge_tasks(&a[i], m - i, &b[k - i], n - k + i, &out[k]);
+    #pragma omp taskwait
+}
+
+// Sort src[0 ... n-1] via task-parallel merge sort; the sorted list is 
+// written to dst if to_dst is set, else to src; the other array is used as
+// work array
+//
+void sort_tasks(int *src, int *dst, int n, int to_dst) {
+    int h = n / 2;
+    int i;
+    if (n <= TASK_CUTOFF) {
+        qsort(src, n, sizeof(int), compare_int);
+        if (to_dst) {
+            for (i = 0; i < n; i++) dst[i] = src[i];
+        }
+        return;
+    }
+
+    // Sort halves into the array that is not the destination, then merge
+    #pragma omp task
+    sort_tasks(src, dst, h, !to_dst);
+    #pragma omp task
+    sort_tasks(&src[h], &dst[h], n - h, !to_dst);
+    #pragma omp taskwait
+
+    if (to_dst) {
+        merge_tasks(src, h, &src[h], n - h, dst);
+    } else {
+        merge_tasks(dst, h, &dst[h], n - h, src);
+    }
+}
+
+// Sort list via task-parallel merge sort; all tasks run in a single
+// parallel region of num_threads threads
+//
+void sort_list_tasks() {
+    #pragma omp parallel
+    {
+        #pragma omp single
+        sort_tasks(list, work, list_size, 0);
+    }
+}
+
+// Initialize list, sort it with num_threads = 2^q threads and check the result
+// Input:
+//	q	- log_2(num_threads)
+//	dist	- input distribution, -1 for lrand48 values
+//	check	- verification mode
+// Output:
+//	*sort_time, *check_time - time taken by sort and by verification
+//	returns error (0 if list has been sorted correctly)
+//
+int sort_and_check(int q, int dist, int check, double *sort_time, double *check_time) {
+
+    struct timespec start, stop, stop_check;
+    list_fingerprint fingerprint_orig = {0, 0};
+    int j, error; 
+
+    // Initialize list of random integers; list will be sorted by 
+    // multi-threaded parallel merge sort
+    if (dist >= 0) {
+        fill_list_int(list, list_size, 0, list_size, num_threads, dist, 0);
+    } else {
+        srand48(0); 	// seed the random number generator
+        for (j = 0; j < list_size; j++) {
+            list[j] = (int) lrand48();
+        }
+        // duplicate first value at last location to test for repeated values
+        list[list_size - 1] = list[0]; 
+    }
+    // Full check: copy list to list_orig; list_orig will be sorted by qsort 
+    // and used to check correctness of multi-threaded parallel merge sort
+    // Fast check: fingerprint of list is compared with that of sorted list
+    if (check == CHECK_FULL) {
+        for (j = 0; j < list_size; j++) {
+            list_orig[j] = list[j];
+        }
+    } else if (check == CHECK_FAST) {
+        fingerprint_orig = check_list(0, &error);
+    }
+
+    clock_gettime(CLOCK_REALTIME, &start);
+
+    // Parallel merge sort 
+    if (sort_mode == SORT_TASKS) {
+        sort_list_tasks();
+    } else if (sort_mode == SORT_BLOCKS) {
+        sort_list_blocks(q);
+    } else {
+        sort_list(q);
+    }
+
+    // Compute time taken
+    clock_gettime(CLOCK_REALTIME, &stop);
+    *sort_time = (stop.tv_sec - start.tv_sec)
+        + 0.000000001 * (stop.tv_nsec - start.tv_nsec);
+
+    // Check answer
+    error = 0; 
+    if (check == CHECK_FULL) {
+        qsort(list_orig, list_size, sizeof(int), compare_int);
+        for (j = 0; j < list_size; j++) {
+            if (list[j] != list_orig[j]) error = 1; 
+        }
+    } else if (check == CHECK_FAST) {
+        if (!fingerprint_equal(check_list(1, &error), fingerprint_orig)) error = 1;
+    }
+    clock_gettime(CLOCK_REALTIME, &stop_check);
+    *check_time = (stop_check.tv_sec - stop.tv_sec)
+        + 0.000000001 * (stop_check.tv_nsec - stop.tv_nsec);
+
+    return error;
+}
+
+// Number of OpenMP threads used to sort 2^q sub-lists
+//
+int team_size() {
+    if (team > 0) return team;
+    if (sort_mode == SORT_BLOCKS) {
+        return (omp_get_num_procs() < num_threads) ? omp_get_num_procs() : num_threads;
+    }
+    return num_threads;
+}
+
 // Main program - set up list of random integers and use threads to sort the list
 //
 // Input: 
 //	k = log_2(list size), therefore list_size = 2^k
 //	q = log_2(num_threads), therefore num_threads = 2^q
+// Options:
+//	-d <distribution>	initialize list with one of the distributions in
+//				../common/list_init.h (default: lrand48 values
+//				with the first value duplicated at the end)
+//	-c none|fast|full	verification of the sorted list: none, parallel
+//				sortedness + fingerprint check (default), or
+//				comparison with list sorted by qsort
+//	-r <repetitions>	benchmark mode: sort the list <repetitions> times
+//				in this process, reusing all allocations, and 
+//				report median/p10/p90 time and throughput
+//	-w <warmup>		benchmark mode: untimed runs before timed ones
+//				(default 2)
+//	-s <q_last>		benchmark mode: sweep q, q+1, ..., q_last
+//	-m merge|tasks		sort algorithm: merge 2^q sorted sub-lists level
+//				by level (default), or recursive task-parallel
+//				merge sort with co-rank partitioned merges,
+//				or level by level merge of 2^q blocks by a 
+//				fixed team of threads in one parallel region
+//	-t <threads>		number of OpenMP threads (default: 2^q, or 
+//				number of processors for -m blocks)
 //
 int main(int argc, char *argv[]) {
 
-    struct timespec start, stop, stop_qsort;
-    double total_time, time_res, total_time_qsort;
-    int k, q, j, error; 
+    double total_time, total_time_check;
+    int k, q, error, i; 
+    int dist = -1;              // Input distribution; -1 for lrand48 values
+    int check = CHECK_FAST;     // Verification mode
+    const char *check_names[] = {"none", "fast", "full"};
+    const char *sort_names[] = {"merge", "tasks", "blocks"};
+    int reps = 0;               // Benchmark repetitions; 0 for a single run
+    int warmup = 2;             // Benchmark warmup runs
+    int q_last = -1;            // Last q of benchmark sweep
+    double *times;              // Benchmark timings
+    double median, p10, p90;
+    int opt;
 
     // Read input, validate
-    if (argc != 3) {
+    while ((opt = getopt(argc, argv, "d:c:r:w:s:m:t:")) != -1) {
+        switch (opt) {
+            case 'd':
+                if ((dist = dist_from_name(optarg)) < 0) {
+                    printf("Unknown distribution: %s. Use one of: ", optarg);
+                    print_dist_names();
+                    exit(0);
+                }
+                break;
+            case 'c':
+                for (check = CHECK_FULL; check >= 0; check--) {
+                    if (strcmp(optarg, check_names[check]) == 0) break;
+                }
+                if (check < 0) {
+                    printf("Unknown verification mode: %s. Use one of: none|fast|full\n", optarg);
+                    exit(0);
+                }
+                break;
+            case 'r':
+                reps = atoi(optarg);
+                break;
+            case 'w':
+                warmup = atoi(optarg);
+                break;
+            case 's':
+                q_last = atoi(optarg);
+                break;
+            case 'm':
+                for (sort_mode = SORT_BLOCKS; sort_mode >= 0; sort_mode--) {
+                    if (strcmp(optarg, sort_names[sort_mode]) == 0) break;
+                }
+                if (sort_mode < 0) {
+                    printf("Unknown sort algorithm: %s. Use one of: merge|tasks|blocks\n", optarg);
+                    exit(0);
+                }
+                break;
+            case 't':
+                team = atoi(optarg);
+                break;
+            default:
+                exit(0);
+        }
+    }
+    if (argc - optind != 2) {
         printf("Need two integers as input \n"); 
-        printf("Use: <executable_name> <log_2(list_size)> <log_2(num_threads)>\n"); 
+        printf("Use: <executable_name> [-d distribution] [-c none|fast|full] [-m merge|tasks|blocks] [-t threads] [-r repetitions [-w warmup] [-s q_last]] <log_2(list_size)> <log_2(num_threads)>\n"); 
         exit(0);
     }
-    k = atoi(argv[argc - 2]);
+    k = atoi(argv[optind]);
     if ((list_size = (1 << k)) > MAX_LIST_SIZE) {
         printf("Maximum list size allowed: %d.\n", MAX_LIST_SIZE);
         exit(0);
     }; 
-    q = atoi(argv[argc - 1]);
-    if ((num_threads = (1 << q)) > MAX_THREADS) {
+    q = atoi(argv[optind + 1]);
+    if (q_last < q) q_last = q;
+    if ((num_threads = (1 << q_last)) > MAX_THREADS) {
         printf("Maximum number of threads allowed: %d.\n", MAX_THREADS);
         exit(0);
     }; 
@@ -225,61 +643,61 @@ int main(int argc, char *argv[]) {
            num_threads, list_size);
         exit(0);
     }; 
+    if ((team < 0) || (team > MAX_THREADS)) {
+        printf("Number of OpenMP threads must be in [1 ... %d].\n", MAX_THREADS);
+        exit(0);
+    }
+    if ((reps < 0) || (warmup < 0)) {
+        printf("Number of repetitions and warmup runs must be non-negative.\n");
+        exit(0);
+    }
 
-    // Set number of OpenMP threads
-    omp_set_num_threads(num_threads);
-
-    // Allocate list, list_orig, and work
+    // Allocate list, list_orig (only needed for full verification), and work
     list = (int *) malloc(list_size * sizeof(int));
-    list_orig = (int *) malloc(list_size * sizeof(int));
+    list_orig = (check == CHECK_FULL) ? (int *) malloc(list_size * sizeof(int)) : NULL;
     work = (int *) malloc(list_size * sizeof(int));
 
-    // Initialize list of random integers; list will be sorted by 
-    // multi-threaded parallel merge sort
-    // Copy list to list_orig; list_orig will be sorted by qsort and used
-    // to check correctness of multi-threaded parallel merge sort
-    srand48(0); 	// seed the random number generator
-    for (j = 0; j < list_size; j++) {
-        list[j] = (int) lrand48();
-        list_orig[j] = list[j];
-    }
-    // duplicate first value at last location to test for repeated values
-    list[list_size - 1] = list[0]; 
-    list_orig[list_size - 1] = list_orig[0];
+    if (reps == 0) {
+        // Set number of OpenMP threads
+        num_threads = 1 << q;
+        omp_set_num_threads(team_size());
 
-    // Create threads; each thread executes find_minimum
-    clock_gettime(CLOCK_REALTIME, &start);
-
-    // Parallel merge sort 
-    sort_list(q);
-
-    // Compute time taken
-    clock_gettime(CLOCK_REALTIME, &stop);
-    total_time = (stop.tv_sec - start.tv_sec)
-        + 0.000000001 * (stop.tv_nsec - start.tv_nsec);
-
-    // Check answer
-    qsort(list_orig, list_size, sizeof(int), compare_int);
-    clock_gettime(CLOCK_REALTIME, &stop_qsort);
-    total_time_qsort = (stop_qsort.tv_sec - stop.tv_sec)
-        + 0.000000001 * (stop_qsort.tv_nsec - stop.tv_nsec);
+        error = sort_and_check(q, dist, check, &total_time, &total_time_check);
 
-    error = 0; 
-    for (j = 1; j < list_size; j++) {
-        if (list[j] != list_orig[j]) error = 1; 
-    }
+        if (error != 0) {
+            printf("Houston, we have a problem!\n"); 
+        }
 
-    if (error != 0) {
-        printf("Houston, we have a problem!\n"); 
+        // Print time taken
+        printf("List Size = %d, Threads = %d, Team = %d, Sort = %s, Distribution = %s, error = %d, time (sec) = %8.4f, check (%s) time = %8.4f\n", 
+            list_size, num_threads, team_size(), sort_names[sort_mode], (dist >= 0) ? dist_names[dist] : "lrand48",
+            error, total_time, check_names[check], total_time_check);
+    } else {
+        // Benchmark: list, work and list_orig are reused by all runs, and the
+        // list is re-initialized before each run (not timed)
+        times = (double *) malloc(reps * sizeof(double));
+        for (; q <= q_last; q++) {
+            num_threads = 1 << q;
+            omp_set_num_threads(team_size());
+            error = 0;
+            for (i = 0; i < warmup + reps; i++) {
+                error |= sort_and_check(q, dist, check, &total_time, &total_time_check);
+                if (i >= warmup) times[i - warmup] = total_time;
+            }
+            if (error != 0) {
+                printf("Houston, we have a problem!\n"); 
+            }
+            bench_stats(times, reps, &median, &p10, &p90);
+            printf("List Size = %d, Threads = %d, Team = %d, Sort = %s, Distribution = %s, error = %d, repetitions = %d, time (sec) = %8.4f, p10 = %8.4f, p90 = %8.4f, throughput (elements/s) = %10.4e\n", 
+                list_size, num_threads, team_size(), sort_names[sort_mode], (dist >= 0) ? dist_names[dist] : "lrand48",
+                error, reps, median, p10, p90, list_size / median);
+        }
+        free(times);
     }
 
-    // Print time taken
-    printf("List Size = %d, Threads = %d, error = %d, time (sec) = %8.4f, qsort_time = %8.4f\n", 
-        list_size, num_threads, error, total_time, total_time_qsort);
-
     // Clean up
     free(list); 
     free(work); 
-    free(list_orig); 
+    if (list_orig != NULL) free(list_orig); 
 
 }
@@ -2,28 +2,281 @@
 // Hypercube Quicksort to sort a list of integers distributed across processors
 // MPI-based implementation
 //
+// Also provides Parallel Sorting by Regular Sampling (PSRS), which runs on
+// any number of processes (-a sample)
+//
+// Hybrid MPI+OpenMP when compiled with OpenMP (e.g. mpicxx -fopenmp): run 
+// one process per node or socket; local sorts and merges then use all 
+// threads of the process (-t or OMP_NUM_THREADS) and only the exchanges 
+// between processes use MPI. All MPI calls are made outside of parallel 
+// regions (MPI_THREAD_FUNNELED).
+//
+// The sorters are templates on the key type (int or long long, -k 32|64)
+// and on the order of the keys, given by a comparison function object
+// (std::less for ascending, std::greater for descending order, -o). Keys
+// are compared by inlined calls of the function object.
+//
+// Records (64-bit key, origin and payload) are sorted either as a whole
+// (-k record), or in key-only mode (-k tuple): (key, origin) tuples are
+// sorted and a final all-to-all moves every record from its origin to the
+// position of its tuple, so payloads cross the network only once.
+//
 #include <cmath>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
+#include <cstddef>
 #include <new>
+#include <algorithm>
+#include <functional>
+#include <unistd.h>
 #include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "../common/list_init.h"
+#include "../common/list_check.h"
 
 #define MAX_LIST_SIZE_PER_PROC	1310720001
 
+// Sublists exchanged by neighbors are sent in messages of at most 
+// EXCHANGE_CHUNK_SIZE elements; received chunks are merged while later 
+// chunks are still in flight
+#define EXCHANGE_CHUNK_SIZE	65536
+
+// Merges of fewer than PARALLEL_MERGE_CUTOFF elements and local lists of 
+// fewer than PARALLEL_SORT_CUTOFF elements are handled by a single thread
+#define PARALLEL_MERGE_CUTOFF	65536
+#define PARALLEL_SORT_CUTOFF	65536
+
+// Pivot selection strategies
+#define PIVOT_MEAN		0	// mean of local medians
+#define PIVOT_WMEDIAN		1	// median of local medians, weighted by 
+					// local list sizes
+#define PIVOT_SAMPLE		2	// weighted median of PIVOT_SAMPLES 
+					// regular samples of each local list
+#define PIVOT_EXACT		3	// global median, via distributed selection
+#define PIVOT_SAMPLES		16
+
+const char * pivot_names[] = {"mean", "wmedian", "sample", "exact"};
+
+// Sorting algorithms
+#define ALGORITHM_HYPERCUBE	0	// hypercube quicksort (power of 2 processes)
+#define ALGORITHM_SAMPLE	1	// parallel sorting by regular sampling
+
+const char * algorithm_names[] = {"hypercube", "sample"};
+
+// Key types
+#define KEY_INT			0	// 32-bit integers
+#define KEY_LONG		1	// 64-bit integers
+#define KEY_RECORD		2	// records, sorted by key
+#define KEY_TUPLE		3	// records, sorted as (key, origin) tuples
+
+const char * key_names[] = {"32", "64", "record", "tuple"};
+
+// Number of 64-bit payload words per record
+#ifndef RECORD_PAYLOAD_WORDS
+#define RECORD_PAYLOAD_WORDS	14
+#endif
+
+// Key orders
+#define ORDER_ASCENDING		0
+#define ORDER_DESCENDING	1
+
+const char * order_names[] = {"ascending", "descending"};
+
+// List initialization types <= TYPE_DIST(0) select a distribution from
+// ../common/list_init.h; distribution d has type TYPE_DIST(d)
+#define TYPE_DIST(d)		(-3-(d))
+#define DIST_OF_TYPE(t)		(-3-(t))
+
 #ifndef VERBOSE
 #define VERBOSE 0			// Use VERBOSE to control output 
 #endif
 
-int compare_int(const void *, const void *);
+// Record: 64-bit key, global index of the record in the initial list and
+// payload; payload words are a function of origin (see Key_Traits<Record>),
+// so check_list can detect records whose payload was lost or mixed up
+struct Record {
+    long long key;
+    long long origin;
+    long long payload[RECORD_PAYLOAD_WORDS];
+};
+
+// Tuple sorted in key-only mode instead of the record with the same origin
+struct Tuple {
+    long long key;
+    long long origin;
+};
+
+// Orders records and tuples by key, in the order of Order (std::less, 
+// std::greater)
+template <class Order> struct By_Key {
+    Order order;
+    template <class T> bool operator()(const T & a, const T & b) const { 
+	return order(a.key, b.key); 
+    }
+};
+
+// Properties of the supported key types: MPI datatype, construction from
+// a 64-bit value (make, fill: list initialization from 
+// ../common/list_init.h), numeric value (for the mean pivot), printing,
+// hash (for the list fingerprint, see ../common/list_check.h) and payload
+// verification (intact)
+template <class Key> struct Key_Traits;
+
+template <> struct Key_Traits<int> {
+    static MPI_Datatype mpi_type() { return MPI_INT; }
+    static const char * name() { return "32-bit"; }
+    static int make(long long value, long long) { return (int) value; }
+    static void fill(int * list, long long n, long long offset, long long total,
+	    int num_blocks, int dist, unsigned long long seed) {
+	fill_list_int(list, n, offset, total, num_blocks, dist, seed);
+    }
+    static long double value(int key) { return key; }
+    static void print(int key) { printf(" %8d", key); }
+    static unsigned long long hash(int key) { return mix64((unsigned long long) (unsigned int) key); }
+    static int intact(int) { return 1; }
+};
+
+template <> struct Key_Traits<long long> {
+    static MPI_Datatype mpi_type() { return MPI_LONG_LONG; }
+    static const char * name() { return "64-bit"; }
+    static long long make(long long value, long long) { return value; }
+    static void fill(long long * list, long long n, long long offset, long long total,
+	    int num_blocks, int dist, unsigned long long seed) {
+	fill_list_long(list, n, offset, total, num_blocks, dist, seed);
+    }
+    static long double value(long long key) { return key; }
+    static void print(long long key) { printf(" %20lld", key); }
+    static unsigned long long hash(long long key) { return mix64((unsigned long long) key); }
+    static int intact(long long) { return 1; }
+};
+
+template <> struct Key_Traits<Record> {
+    // Derived datatype of Record; created on first use
+    static MPI_Datatype mpi_type() { 
+	static MPI_Datatype type = MPI_DATATYPE_NULL;
+	if (type == MPI_DATATYPE_NULL) {
+	    int block_lengths[3] = {1, 1, RECORD_PAYLOAD_WORDS};
+	    MPI_Aint displs[3] = {offsetof(Record, key), offsetof(Record, origin), 
+		offsetof(Record, payload)};
+	    MPI_Datatype types[3] = {MPI_LONG_LONG, MPI_LONG_LONG, MPI_LONG_LONG};
+	    MPI_Datatype record_type;
+	    MPI_Type_create_struct(3, block_lengths, displs, types, &record_type);
+	    MPI_Type_create_resized(record_type, 0, sizeof(Record), &type);
+	    MPI_Type_free(&record_type);
+	    MPI_Type_commit(&type);
+	}
+	return type;
+    }
+    static const char * name() { return "record"; }
+    static unsigned long long payload(long long origin, int i) { 
+	return mix64((unsigned long long) origin * RECORD_PAYLOAD_WORDS + i);
+    }
+    static Record make(long long value, long long origin) { 
+	Record r;
+	r.key = value;
+	r.origin = origin;
+	for (int i = 0; i < RECORD_PAYLOAD_WORDS; i++) r.payload[i] = (long long) payload(origin, i);
+	return r;
+    }
+    static void fill(Record * list, long long n, long long offset, long long total,
+	    int num_blocks, int dist, unsigned long long seed) {
+	for (long long j = 0; j < n; j++) {
+	    list[j] = make((long long) dist_value(dist, offset+j, total, num_blocks, seed, 1ULL << 63), 
+		    offset+j);
+	}
+    }
+    static long double value(const Record & r) { return r.key; }
+    static void print(const Record & r) { printf(" %20lld", r.key); }
+    static unsigned long long hash(const Record & r) { 
+	return mix64((unsigned long long) r.key ^ mix64((unsigned long long) r.origin)); 
+    }
+    static int intact(const Record & r) { 
+	for (int i = 0; i < RECORD_PAYLOAD_WORDS; i++) {
+	    if (r.payload[i] != (long long) payload(r.origin, i)) return 0;
+	}
+	return 1;
+    }
+};
+
+template <> struct Key_Traits<Tuple> {
+    // Derived datatype of Tuple; created on first use
+    static MPI_Datatype mpi_type() { 
+	static MPI_Datatype type = MPI_DATATYPE_NULL;
+	if (type == MPI_DATATYPE_NULL) {
+	    MPI_Type_contiguous(2, MPI_LONG_LONG, &type);
+	    MPI_Type_commit(&type);
+	}
+	return type;
+    }
+    static const char * name() { return "tuple"; }
+    static Tuple make(long long value, long long origin) { 
+	Tuple t = {value, origin};
+	return t;
+    }
+    static void fill(Tuple * list, long long n, long long offset, long long total,
+	    int num_blocks, int dist, unsigned long long seed) {
+	for (long long j = 0; j < n; j++) {
+	    list[j] = make((long long) dist_value(dist, offset+j, total, num_blocks, seed, 1ULL << 63), 
+		    offset+j);
+	}
+    }
+    static long double value(const Tuple & t) { return t.key; }
+    static void print(const Tuple & t) { printf(" %20lld", t.key); }
+    static unsigned long long hash(const Tuple & t) { 
+	return mix64((unsigned long long) t.key ^ mix64((unsigned long long) t.origin)); 
+    }
+    static int intact(const Tuple &) { return 1; }
+};
+
+// Last element of the lists of a range of processes; valid is 0 if all 
+// lists of the range are empty. Combined by MPI_Exscan with last_element
+template <class Key> struct Last_Element {
+    Key value;
+    int valid;
+};
+
+// MPI reduction operator for Last_Element: the last element of the lists 
+// of two adjacent ranges of processes is the last element of the second 
+// range, or of the first range if all lists of the second range are empty 
+// (associative, not commutative)
+//
+template <class Key>
+void last_element(void * in, void * inout, int * len, MPI_Datatype *) {
+    Last_Element<Key> * first = (Last_Element<Key> *) in;
+    Last_Element<Key> * second = (Last_Element<Key> *) inout;
+    for (int i = 0; i < *len; i++) {
+	if (!second[i].valid) second[i] = first[i];
+    }
+}
+
+// A candidate pivot and the number of list elements it represents; 
+// exchanged as sizeof(Value_Weight) bytes
+template <class Key> struct Value_Weight {
+    Key value;
+    int weight;
+};
 
-class HyperCube_Class {
+// List distributed across all processes: list initialization, verification
+// and the buffers and helpers shared by the sorting algorithms
+// Template parameters:
+//   Key	- key type (see Key_Traits)
+//   Compare	- comparison function object; the list is sorted such that
+//   		  comp(list[j], list[j-1]) is false for all j
+template <class Key, class Compare> class Distributed_List_Class {
     public:
-	void Initialize(int, int, int);
-	void HyperCube_QuickSort();
+	virtual ~Distributed_List_Class() {}
+	void Initialize(int, int);
+	virtual void Finalize();
+	virtual void Sort() = 0;
 	void print_list();
 	void check_list();
-
-	int dimension;		// Hypercube dimension
+	double load_report(double *, double *, double *, double *);
+	void rebalance();
+	Key * local_list() { return list; }
 
 	int num_procs; 		// Number of MPI processes
 	int my_id;		// Rank/id of this process
@@ -31,57 +284,236 @@ class HyperCube_Class {
 	int list_size;		// Local list size
 	int list_size_initial;	// Size of initial local list (before sorting)
 
+    protected:
+	list_fingerprint initial_fingerprint;	// Fingerprint of initial local list
+
+	Key * initialize_list(int);
+	void sort_local_list();
+	void merged_list(Key *, int, Key *, int, Key *); 
+	void merged_list_serial(Key *, int, Key *, int, Key *); 
+	int co_rank(int, Key *, int, Key *, int); 
+	int split_list_index (Key *, int, Key); 
+	void reserve(Key *&, int &, int, int);
+	void print_local_list(int, Key *, int);
+	list_fingerprint local_fingerprint();
+
+	Compare comp;		// Key order
+	MPI_Datatype key_type;	// MPI datatype of keys
+
+	Key *list;		// Local list
+	int list_capacity;	// Number of elements allocated for list
+
+	// Work array; received elements are merged into scratch, then list and 
+	// scratch are swapped, so both buffers are reused by all exchanges
+	Key *scratch;
+	int scratch_capacity;	// Number of elements allocated for scratch
+};
+
+template <class Key, class Compare>
+class HyperCube_Class : public Distributed_List_Class<Key, Compare> {
+    typedef Distributed_List_Class<Key, Compare> Base;
+    using Base::num_procs; using Base::my_id; using Base::comp; using Base::key_type;
+    using Base::list; using Base::list_size; using Base::list_capacity;
+    using Base::scratch; using Base::scratch_capacity;
+    using Base::merged_list; using Base::split_list_index; using Base::reserve;
+
+    public:
+	void Initialize(int, int, int);
+	void Finalize();
+	void Sort() { HyperCube_QuickSort(); }
+	void HyperCube_QuickSort();
+
+	int dimension;		// Hypercube dimension
+	int pivot_strategy;	// Pivot selection strategy (PIVOT_MEAN, ...)
+
     private:
-	int * initialize_list(int);
 	int neighbor_along_dim_k(int );
-	int * merged_list(int *, int, int *, int); 
-	int split_list_index (int *, int, int); 
-	void print_local_list();
+	void exchange_merged_list(int, int, int, int, int); 
+	Key select_pivot(int);
+	Key weighted_median(Value_Weight<Key> *, int);
+
+	// Communicators of the sub-hypercubes that include this process; 
+	// sub_hypercube_comm[k] (k = 1 ... dimension) contains all processes 
+	// with ranks that differ from this process in the lowest k bits only
+	MPI_Comm * sub_hypercube_comm;
+};
+
+// Parallel Sorting by Regular Sampling: every process sorts its local list
+// and contributes num_procs regular samples; num_procs-1 splitters chosen 
+// from the sorted samples define the value range of each process. All 
+// elements are moved in a single MPI_Alltoallv and the num_procs sorted 
+// runs received by a process are combined by a k-way merge.
+template <class Key, class Compare>
+class SampleSort_Class : public Distributed_List_Class<Key, Compare> {
+    typedef Distributed_List_Class<Key, Compare> Base;
+    using Base::num_procs; using Base::comp; using Base::key_type;
+    using Base::list; using Base::list_size; using Base::list_capacity;
+    using Base::scratch; using Base::scratch_capacity;
+    using Base::split_list_index; using Base::reserve;
 
-	int *list;		// Local list
+    public:
+	void Sort() { SampleSort(); }
+	void SampleSort();
+
+    private:
+	void select_splitters(Key *);
+	void kway_merge(Key *, int *, int *, int, Key *);
 };
 
 //
-// Initialize HyperCube
+// Initialize distributed list
 //
-void HyperCube_Class::Initialize(int dim, int size, int type) {
-
-    dimension = dim; 		// Hypercube dimension
+template <class Key, class Compare>
+void Distributed_List_Class<Key, Compare>::Initialize(int size, int type) {
 
     MPI_Comm_size(MPI_COMM_WORLD,&num_procs);	// num_procs = number of MPI processes
     MPI_Comm_rank(MPI_COMM_WORLD,&my_id);	// my_id = rank of this process
 
+    key_type = Key_Traits<Key>::mpi_type();
+
     list_size_initial = size;
     list_size = list_size_initial; 
 
     // Call initialize_list after initializing 
     // num_procs, my_id, and list_size
     list = initialize_list(type);	// Initialize local list
+    initial_fingerprint = local_fingerprint();
+    list_capacity = list_size;
+    scratch = new Key[list_size];
+    scratch_capacity = list_size;
+}
+
+//
+// Free list buffers; call before MPI_Finalize
+//
+template <class Key, class Compare>
+void Distributed_List_Class<Key, Compare>::Finalize() {
+    delete [] list;
+    delete [] scratch;
+}
+
+//
+// Initialize HyperCube
+//
+template <class Key, class Compare>
+void HyperCube_Class<Key, Compare>::Initialize(int dim, int size, int type) {
+
+    dimension = dim; 		// Hypercube dimension
+    pivot_strategy = PIVOT_MEAN;
+
+    Base::Initialize(size, type);
+
+    // Construct communicators for all sub-hypercubes once; they are used
+    // for the pivot computation in every call to HyperCube_QuickSort
+    sub_hypercube_comm = new MPI_Comm[dimension+1];
+    for (int k = 1; k <= dimension; k++) {
+	MPI_Comm_split(MPI_COMM_WORLD, my_id >> k, my_id, &sub_hypercube_comm[k]);
+    }
+}
+
+//
+// Free HyperCube resources; call before MPI_Finalize
+//
+template <class Key, class Compare>
+void HyperCube_Class<Key, Compare>::Finalize() {
+    for (int k = 1; k <= dimension; k++) {
+	MPI_Comm_free(&sub_hypercube_comm[k]);
+    }
+    delete [] sub_hypercube_comm;
+    Base::Finalize();
+}
+
+// Make sure buffer has room for at least size elements; a larger buffer is
+// allocated (by at least 50% to keep the number of reallocations small) if 
+// needed and its first valid_size elements are preserved
+// Input/Output:
+//   buffer, capacity	- buffer and number of elements allocated for it
+//
+template <class Key, class Compare>
+void Distributed_List_Class<Key, Compare>::reserve(Key *& buffer, int & capacity, int size, int valid_size) {
+    if (size <= capacity) return;
+    int new_capacity = capacity + capacity/2;
+    if (new_capacity < size) new_capacity = size;
+    Key * new_buffer = new Key[new_capacity];
+    for (int j = 0; j < valid_size; j++) {
+	new_buffer[j] = buffer[j];
+    }
+    delete [] buffer;
+    buffer = new_buffer;
+    capacity = new_capacity;
 }
 
 // Computes the rank of neighbor process along dimension k (k > 0) of 
 // the hypercube. Rank is computed by flipping the kth bit of rank/id of 
 // this process
 //
-int HyperCube_Class::neighbor_along_dim_k(int k) {
+template <class Key, class Compare>
+int HyperCube_Class<Key, Compare>::neighbor_along_dim_k(int k) {
     int mask = 1 << (k-1); 
     return (my_id ^ mask); 
 }
 
-// Merge two sorted lists and return the merged list
+// Co-rank of output position k in the merge of sorted lists 
+// list1[0 ... list1_size-1] and list2[0 ... list2_size-1]: returns i such 
+// that the first k elements of the merged list are list1[0 ... i-1] and 
+// list2[0 ... k-i-1] (elements of list1 come first on ties)
+//
+template <class Key, class Compare>
+int Distributed_List_Class<Key, Compare>::co_rank(int k, Key * list1, int list1_size, Key * list2, int list2_size) {
+    int lo = (k > list2_size) ? k - list2_size : 0;
+    int hi = (k < list1_size) ? k : list1_size;
+    int mid;
+    while (lo < hi) {
+	mid = (lo + hi) / 2;
+	if (!comp(list2[k - mid - 1], list1[mid])) {
+	    lo = mid + 1;
+	} else {
+	    hi = mid;
+	}
+    }
+    return lo;
+}
+
+// Merge two sorted lists; with OpenMP, large merges are split into equal 
+// parts of the merged list (via co_rank) that are merged by separate threads
 // Input:
 //   list1, list1_size	- first list and its size
 //   list2, list2_size	- second list and its size
 // Output:
-//   list		- merged list (size not returned!)
+//   list		- merged list of size list1_size+list2_size
 //
-int * HyperCube_Class::merged_list(int * list1, int list1_size, int * list2, int list2_size) {
-    int * list = new int[list1_size+list2_size];
+template <class Key, class Compare>
+void Distributed_List_Class<Key, Compare>::merged_list(Key * list1, int list1_size, Key * list2, int list2_size, Key * list) {
+#ifdef _OPENMP
+    if ((list1_size + list2_size >= PARALLEL_MERGE_CUTOFF) && (omp_get_max_threads() > 1) 
+	    && !omp_in_parallel()) {
+	#pragma omp parallel
+	{
+	    int num_threads = omp_get_num_threads();
+	    int t = omp_get_thread_num();
+	    int total = list1_size + list2_size;
+	    int first = (int) (((long long) t * total) / num_threads);
+	    int last = (int) (((long long) (t+1) * total) / num_threads);
+	    int first1 = co_rank(first, list1, list1_size, list2, list2_size);
+	    int last1 = co_rank(last, list1, list1_size, list2, list2_size);
+	    merged_list_serial(&list1[first1], last1-first1, &list2[first-first1], 
+		    (last-last1)-(first-first1), &list[first]);
+	}
+	return;
+    }
+#endif
+    merged_list_serial(list1, list1_size, list2, list2_size, list);
+}
+
+// Merge two sorted lists (single thread); see merged_list
+//
+template <class Key, class Compare>
+void Distributed_List_Class<Key, Compare>::merged_list_serial(Key * list1, int list1_size, Key * list2, int list2_size, Key * list) {
     int idx1 = 0; 
     int idx2 = 0; 
     int idx = 0; 
     while ((idx1 < list1_size) && (idx2 < list2_size)) {
-	if (list1[idx1] <= list2[idx2]) {
+	if (!comp(list2[idx2], list1[idx1])) {
 	    list[idx] = list1[idx1]; 
 	    idx++; idx1++;
 	} else {
@@ -97,22 +529,23 @@ int * HyperCube_Class::merged_list(int * list1, int list1_size, int * list2, int
 	list[idx] = list2[idx2]; 
 	idx++; idx2++;
     }
-    return list;
 }
 
-// Search for smallest element in a sorted list which is larger than pivot
+// Search for first element in a sorted list which comes after pivot (i.e.
+// is larger than pivot in ascending order)
 // Uses binary search since list is sorted.
 // Input:
 //   list, list_size	- list and its size
 //   pivot		- value to search for
 // Output:
-//   last 	- index of the smallest element that is larger than the pivot
+//   last 	- index of the first element that comes after the pivot
 //
-int HyperCube_Class::split_list_index (int *list, int list_size, int pivot) {
+template <class Key, class Compare>
+int Distributed_List_Class<Key, Compare>::split_list_index (Key *list, int list_size, Key pivot) {
     int first, last, mid;  
     first = 0; last = list_size; mid = (first+last)/2;
     while (first < last) {
-	if (list[mid] <= pivot) {
+	if (!comp(pivot, list[mid])) {
 	    first = mid+1; mid = (first+last)/2;
 	} else {
 	    last = mid; mid = (first+last)/2;
@@ -121,108 +554,304 @@ int HyperCube_Class::split_list_index (int *list, int list_size, int pivot) {
     return last;
 }
 
-// Print local list
+// Send a sublist of the local list to neighbor process nbr and merge the
+// sublist received from nbr with the sublist that is kept. Both directions 
+// are transferred at the same time in chunks of EXCHANGE_CHUNK_SIZE elements.
+// Each received chunk is merged with all kept elements that do not come
+// after its last element while the following chunks are still being
+// transferred.
+// The neighbor's sublist is received into the tail of list (after 
+// list[list_size-1]) and the merged list is written to scratch; then list 
+// and scratch are swapped.
+// Input:
+//   nbr			- neighbor process
+//   send_first, send_size	- list[send_first ... send_first+send_size-1] 
+//   				  is sent to nbr
+//   keep_first, keep_size	- list[keep_first ... keep_first+keep_size-1] 
+//   				  is kept
+// Output:
+//   list, list_size		- merged list and its size
+//
+template <class Key, class Compare>
+void HyperCube_Class<Key, Compare>::exchange_merged_list(int nbr, int send_first, int send_size,
+	int keep_first, int keep_size) {
+    int tag = 0;
+    int nbr_list_size;		// Size of sublist received from nbr
+    int num_send_chunks, num_recv_chunks, c;
+    int nbr_first, nbr_last;	// Chunk c is nbr_list[nbr_first ... nbr_last-1]
+    int merge_first, merge_last;// keep_list[merge_first ... merge_last-1] is 
+    				// merged with chunk c
+    MPI_Request * send_requests; 
+    MPI_Request * recv_requests; 
+
+    // Exchange sublist sizes
+    MPI_Sendrecv(&send_size, 1, MPI_INT, nbr, tag, &nbr_list_size, 1, MPI_INT, nbr, tag, 
+	    MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+    // Grow buffers if needed (before pointers into list are taken)
+    reserve(list, list_capacity, list_size + nbr_list_size, list_size);
+    reserve(scratch, scratch_capacity, keep_size + nbr_list_size, 0);
+
+    Key * send_list = &list[send_first];
+    Key * keep_list = &list[keep_first];
+    Key * nbr_list = &list[list_size];
+
+    // Post all receives, then all sends
+    num_recv_chunks = (nbr_list_size + EXCHANGE_CHUNK_SIZE-1) / EXCHANGE_CHUNK_SIZE;
+    num_send_chunks = (send_size + EXCHANGE_CHUNK_SIZE-1) / EXCHANGE_CHUNK_SIZE;
+    recv_requests = new MPI_Request[num_recv_chunks];
+    send_requests = new MPI_Request[num_send_chunks];
+    for (c = 0; c < num_recv_chunks; c++) {
+	nbr_first = c * EXCHANGE_CHUNK_SIZE;
+	nbr_last = (c+1 < num_recv_chunks) ? nbr_first + EXCHANGE_CHUNK_SIZE : nbr_list_size;
+	MPI_Irecv(&nbr_list[nbr_first], nbr_last-nbr_first, key_type, nbr, tag, 
+		MPI_COMM_WORLD, &recv_requests[c]);
+    }
+    for (c = 0; c < num_send_chunks; c++) {
+	nbr_first = c * EXCHANGE_CHUNK_SIZE;
+	nbr_last = (c+1 < num_send_chunks) ? nbr_first + EXCHANGE_CHUNK_SIZE : send_size;
+	MPI_Isend(&send_list[nbr_first], nbr_last-nbr_first, key_type, nbr, tag, 
+		MPI_COMM_WORLD, &send_requests[c]);
+    }
+
+    // Merge chunks in the order they are sent; all kept elements that do
+    // not come after the last element of chunk c precede the elements of
+    // the chunks after c
+    merge_first = 0;
+    for (c = 0; c < num_recv_chunks; c++) {
+	nbr_first = c * EXCHANGE_CHUNK_SIZE;
+	nbr_last = (c+1 < num_recv_chunks) ? nbr_first + EXCHANGE_CHUNK_SIZE : nbr_list_size;
+	MPI_Wait(&recv_requests[c], MPI_STATUS_IGNORE);
+	if (c+1 < num_recv_chunks) {
+	    merge_last = merge_first + split_list_index(&keep_list[merge_first], 
+		    keep_size-merge_first, nbr_list[nbr_last-1]);
+	} else {
+	    merge_last = keep_size;
+	}
+	merged_list(&keep_list[merge_first], merge_last-merge_first, 
+		&nbr_list[nbr_first], nbr_last-nbr_first, &scratch[merge_first+nbr_first]);
+	merge_first = merge_last;
+    }
+    if (num_recv_chunks == 0) {
+	merged_list(keep_list, keep_size, nbr_list, 0, scratch);
+    }
+
+    MPI_Waitall(num_send_chunks, send_requests, MPI_STATUSES_IGNORE);
+
+    delete [] send_requests;
+    delete [] recv_requests;
+
+    // Merged list becomes the local list
+    Key * tmp = list; list = scratch; scratch = tmp;
+    int tmp_capacity = list_capacity; list_capacity = scratch_capacity; scratch_capacity = tmp_capacity;
+    list_size = keep_size + nbr_list_size;
+}
+
+// Sort local list; with OpenMP, a large list is split into one block per 
+// thread, blocks are sorted in parallel and then merged pairwise (each 
+// merge uses all threads, see merged_list), alternating between list and 
+// scratch
+//
+template <class Key, class Compare>
+void Distributed_List_Class<Key, Compare>::sort_local_list() {
+#ifdef _OPENMP
+    int num_blocks = omp_get_max_threads();
+    if ((num_blocks > 1) && (list_size >= PARALLEL_SORT_CUTOFF)) {
+	int * block_first = new int[num_blocks+1];	// Block b is list[block_first[b] ... block_first[b+1]-1]
+	int b, width, j;
+	for (b = 0; b <= num_blocks; b++) {
+	    block_first[b] = (int) (((long long) b * list_size) / num_blocks);
+	}
+	#pragma omp parallel for schedule(static, 1)
+	for (b = 0; b < num_blocks; b++) {
+	    std::sort(&list[block_first[b]], &list[block_first[b+1]], comp);
+	}
+
+	// Merge sorted runs of width blocks into runs of 2*width blocks
+	reserve(scratch, scratch_capacity, list_size, 0);
+	for (width = 1; width < num_blocks; width *= 2) {
+	    for (b = 0; b < num_blocks; b += 2*width) {
+		int first = block_first[b];
+		int mid = block_first[(b+width < num_blocks) ? b+width : num_blocks];
+		int last = block_first[(b+2*width < num_blocks) ? b+2*width : num_blocks];
+		if (mid < last) {
+		    merged_list(&list[first], mid-first, &list[mid], last-mid, &scratch[first]);
+		} else {
+		    for (j = first; j < last; j++) scratch[j] = list[j];
+		}
+	    }
+	    Key * tmp = list; list = scratch; scratch = tmp;
+	    int tmp_capacity = list_capacity; list_capacity = scratch_capacity; scratch_capacity = tmp_capacity;
+	}
+	delete [] block_first;
+	return;
+    }
+#endif
+    std::sort(list, list + list_size, comp);
+}
+
+// Print local list of process id
 //
-void HyperCube_Class::print_local_list() {
+template <class Key, class Compare>
+void Distributed_List_Class<Key, Compare>::print_local_list(int id, Key * local, int size) {
     int j;
-    for (j = 0; j < list_size; j++) {
-	if ((j % 8) == 0) printf("[Proc: %0d]", my_id);
-	printf(" %8d", list[j]); 
+    for (j = 0; j < size; j++) {
+	if ((j % 8) == 0) printf("[Proc: %0d]", id);
+	Key_Traits<Key>::print(local[j]); 
 	if ((j % 8) == 7) printf("\n"); 
     }
     printf("\n"); 
     return;
 }
 
-// Print list: processes print local lists in order of their ranks (from 0 to p-1)
+// Print list: local lists are gathered on process 0, which prints them in 
+// order of their ranks (from 0 to p-1)
 //
-void HyperCube_Class::print_list() {
-    int tag = 0;
-    int dummy = 0;
-    MPI_Status status; 
-    if (my_id-1 >= 0) {
-	MPI_Recv(&dummy, 1, MPI_INT, my_id-1, tag, MPI_COMM_WORLD, &status);
+template <class Key, class Compare>
+void Distributed_List_Class<Key, Compare>::print_list() {
+    int * sizes = NULL;
+    int * displs = NULL;
+    Key * all = NULL;
+    int i, total = 0;
+    if (my_id == 0) {
+	sizes = new int[num_procs];
+	displs = new int[num_procs];
     }
-    print_local_list(); 
-    if (my_id+1 < num_procs) {
-	MPI_Send(&dummy, 1, MPI_INT, my_id+1, tag, MPI_COMM_WORLD);
+    MPI_Gather(&list_size, 1, MPI_INT, sizes, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (my_id == 0) {
+	for (i = 0; i < num_procs; i++) {
+	    displs[i] = total;
+	    total += sizes[i];
+	}
+	all = new Key[total];
+    }
+    MPI_Gatherv(list, list_size, key_type, all, sizes, displs, key_type, 0, MPI_COMM_WORLD);
+    if (my_id == 0) {
+	for (i = 0; i < num_procs; i++) {
+	    print_local_list(i, &all[displs[i]], sizes[i]);
+	}
+	delete [] all;
+	delete [] displs;
+	delete [] sizes;
     }
 }
 
 // Allocate and initialize local list
 // Input: 
 //   type 	- initialization type (elements in increasing  order, 
-//  		  decreasing order, random, other types can be added)
+//  		  decreasing order, random, or one of the distributions
+//  		  in ../common/list_init.h, see TYPE_DIST)
 // Output: 
-//   list	- integer array of size list_size containing elements of
-//   		  list
+//   list	- array of size list_size containing elements of list
 //
-int * HyperCube_Class::initialize_list(int type) {
+template <class Key, class Compare>
+Key * Distributed_List_Class<Key, Compare>::initialize_list(int type) {
     int j;
-    int * list = new int[list_size]; 
+    Key * list = new Key[list_size]; 
     switch (type) {
 	case -1:	// Elements are in descending order
 	    for (j = 0; j < list_size; j++) {
-		list[j] = (num_procs-my_id)*list_size-j;
+		list[j] = Key_Traits<Key>::make((long long) (num_procs-my_id)*list_size-j, 
+			(long long) my_id*list_size+j);
 	    }
 	    break;
 	case -2:	// Elements are in ascending order
 	    for (j = 0; j < list_size; j++) {
-		list[j] = my_id*list_size+j+1;
+		list[j] = Key_Traits<Key>::make((long long) my_id*list_size+j+1, 
+			(long long) my_id*list_size+j);
 	    }
 	    break;
 	default: 
+	    if (type <= TYPE_DIST(0)) {
+		// Global list of size num_procs*list_size; this process holds 
+		// elements my_id*list_size ... (my_id+1)*list_size-1
+		Key_Traits<Key>::fill(list, list_size, (long long) my_id*list_size, 
+			(long long) num_procs*list_size, num_procs, DIST_OF_TYPE(type), 0);
+		break;
+	    }
 	    srand48(type + my_id); 
-	    list[0] = lrand48() % 100;
+	    list[0] = Key_Traits<Key>::make(lrand48() % 100, (long long) my_id*list_size);
 	    for (j = 1; j < list_size; j++) {
-		list[j] = lrand48() % 100;
+		list[j] = Key_Traits<Key>::make(lrand48() % 100, (long long) my_id*list_size+j);
 	    }
 	    break;
     }
     return list;
 }
 
+// Fingerprint of the keys of the local list (see ../common/list_check.h)
+//
+template <class Key, class Compare>
+list_fingerprint Distributed_List_Class<Key, Compare>::local_fingerprint() {
+    list_fingerprint f = {0, 0};
+    unsigned long long h;
+    for (int j = 0; j < list_size; j++) {
+	h = Key_Traits<Key>::hash(list[j]);
+	f.sum += h;
+	f.xor_ ^= h;
+    }
+    return f;
+}
+
 // Check if list is sorted. 
-// Each process verifies that its local list is sorted in ascending order.
-// The process also checks that its list has values larger than or equal to
-// the largest value on the process before it (i.e., on process (my_id-1).
+// Each process verifies that its local list is sorted in the order given by
+// comp (and that record payloads are intact). The process also checks that 
+// no element of its list comes before the last element on the processes 
+// before it; these elements are computed for all processes at once by 
+// MPI_Exscan. Finally the fingerprint of all keys (sum and xor of key 
+// hashes, summed by MPI_Allreduce) must match the fingerprint of the 
+// initial list, so no key was lost, duplicated or changed.
 // Prints result of error check if VERBOSE > 1 
 //
-void HyperCube_Class::check_list() {
-    int tag = 0;
-    int max_nbr = -1;		// Assumes list contains non-negative integers; 6-21-2017
+template <class Key, class Compare>
+void Distributed_List_Class<Key, Compare>::check_list() {
     int error, local_error;
-    int j, my_max;
-    MPI_Status status; 
-    // Receive largest list value from process with rank (my_id-1)
-    if (my_id-1 >= 0) {
-	MPI_Recv(&max_nbr, 1, MPI_INT, my_id-1, tag, MPI_COMM_WORLD, &status);
-	// Good practice to check status!
-    }
-    // Check that the local list is sorted and that elements are larger than 
-    // or equal to the largest on process with rank (my_id-1)
+    int j;
+    Last_Element<Key> my_last, last_before;	// Last element on this process
+						// and on processes before it
+    MPI_Datatype last_element_type;
+    MPI_Op last_element_op;
+
+    // Last element on processes 0 ... my_id-1 (undefined on process 0)
+    my_last.valid = (list_size > 0);
+    my_last.value = (list_size > 0) ? list[list_size-1] : Key();
+    last_before.valid = 0;
+    MPI_Type_contiguous(sizeof(Last_Element<Key>), MPI_BYTE, &last_element_type);
+    MPI_Type_commit(&last_element_type);
+    MPI_Op_create(last_element<Key>, 0, &last_element_op);
+    MPI_Exscan(&my_last, &last_before, 1, last_element_type, last_element_op, MPI_COMM_WORLD);
+    MPI_Op_free(&last_element_op);
+    MPI_Type_free(&last_element_type);
+    if (my_id == 0) last_before.valid = 0;
+
+    // Check that the local list is sorted and that no element comes before 
+    // the last element on the processes before this one
     // (error is set to 1 if a pair of elements is not sorted correctly)
     local_error = 0;
     if (list_size > 0) {
-	if (list[0] < max_nbr) local_error = 1; 
+	if (last_before.valid && comp(list[0], last_before.value)) local_error = 1;
 	for (j = 1; j < list_size; j++) {
-	    if (list[j] < list[j-1]) local_error = 1;
+	    if (comp(list[j], list[j-1])) local_error = 1;
+	}
+	for (j = 0; j < list_size; j++) {
+	    if (!Key_Traits<Key>::intact(list[j])) local_error = 1;
 	}
-	my_max = list[list_size-1];
-    } else {					// Modified 6-21-2017
-	my_max = max_nbr;			// Modified 6-21-2017
     }
     if (VERBOSE > 1) {
 	printf("[Proc: %0d] check_list: local_error = %d\n", my_id, local_error);
     }
-    // Send largest list value to process with rank (my_id+1)
-    if (my_id+1 < num_procs) {
-	MPI_Send(&my_max, 1, MPI_INT, my_id+1, tag, MPI_COMM_WORLD);
-	// Good practice to check status!
-    }
+
+    // Compare fingerprints of initial and sorted list
+    list_fingerprint f = local_fingerprint();
+    unsigned long long sums[2] = {initial_fingerprint.sum, f.sum};
+    unsigned long long xors[2] = {initial_fingerprint.xor_, f.xor_};
+    unsigned long long global_sums[2], global_xors[2];
+    MPI_Allreduce(sums, global_sums, 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(xors, global_xors, 2, MPI_UNSIGNED_LONG_LONG, MPI_BXOR, MPI_COMM_WORLD);
+
     // Collect errors from all processes
-    // error = 0;
     MPI_Reduce(&local_error, &error, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    if ((global_sums[0] != global_sums[1]) || (global_xors[0] != global_xors[1])) error++;
     if (my_id == 0) {
 	if (error == 0) {
 	    printf("[Proc: %0d] Congratulations. The list has been sorted correctly.\n", my_id);
@@ -231,80 +860,242 @@ void HyperCube_Class::check_list() {
 	}
     }
 }
+
+// Weighted median of candidate pivots: the first value (in key order) such
+// that the candidates up to and including it represent at least half of the
+// total weight
+// Input:
+//   candidates, num_candidates	- candidate pivots (sorted on output)
+//
+template <class Key, class Compare>
+Key HyperCube_Class<Key, Compare>::weighted_median(Value_Weight<Key> * candidates, int num_candidates) {
+    long long total_weight = 0, weight = 0;
+    int i;
+    if (num_candidates == 0) return Key();
+    std::sort(candidates, candidates + num_candidates,
+	    [this](const Value_Weight<Key> & a, const Value_Weight<Key> & b) { return comp(a.value, b.value); });
+    for (i = 0; i < num_candidates; i++) {
+	total_weight += candidates[i].weight;
+    }
+    for (i = 0; i < num_candidates; i++) {
+	weight += candidates[i].weight;
+	if (2*weight >= total_weight) break;
+    }
+    return candidates[(i < num_candidates) ? i : num_candidates-1].value;
+}
+
+// Compute pivot for the sub-hypercube of dimension k
+// Input:
+//   k		- sub-hypercube dimension; processes of the sub-hypercube 
+//   		  communicate via sub_hypercube_comm[k]
+// Output:
+//   pivot	- value used to split local lists; list elements that do not
+//   		  come after the pivot go to the lower half of the sub-hypercube
+//
+template <class Key, class Compare>
+Key HyperCube_Class<Key, Compare>::select_pivot(int k) {
+    MPI_Comm comm = sub_hypercube_comm[k];
+    int sub_hypercube_size = 1 << k;
+    int value_weight_size = sizeof(Value_Weight<Key>);
+    Key pivot = Key();
+    int i, num_samples, num_candidates;
+
+    switch (pivot_strategy) {
+	case PIVOT_WMEDIAN: {
+	    // Gather (median, size) of all local lists of the sub-hypercube
+	    Value_Weight<Key> my_median = {(list_size > 0) ? list[list_size/2] : Key(), list_size};
+	    Value_Weight<Key> * medians = new Value_Weight<Key>[sub_hypercube_size];
+	    MPI_Allgather(&my_median, value_weight_size, MPI_BYTE,
+		    medians, value_weight_size, MPI_BYTE, comm);
+	    pivot = weighted_median(medians, sub_hypercube_size);
+	    delete [] medians;
+	    break;
+	}
+	case PIVOT_SAMPLE: {
+	    // Gather PIVOT_SAMPLES regular samples of each local list; each 
+	    // sample represents list_size/PIVOT_SAMPLES elements
+	    Value_Weight<Key> my_samples[PIVOT_SAMPLES];
+	    int * counts = new int[sub_hypercube_size];
+	    int * displs = new int[sub_hypercube_size];
+	    num_samples = (list_size < PIVOT_SAMPLES) ? list_size : PIVOT_SAMPLES;
+	    for (i = 0; i < num_samples; i++) {
+		my_samples[i].value = list[(int) (((2LL*i+1) * list_size) / (2*num_samples))];
+		my_samples[i].weight = list_size / num_samples;
+	    }
+	    num_samples *= value_weight_size;
+	    MPI_Allgather(&num_samples, 1, MPI_INT, counts, 1, MPI_INT, comm);
+	    num_candidates = 0;
+	    for (i = 0; i < sub_hypercube_size; i++) {
+		displs[i] = num_candidates;
+		num_candidates += counts[i];
+	    }
+	    Value_Weight<Key> * samples = new Value_Weight<Key>[num_candidates / value_weight_size];
+	    MPI_Allgatherv(my_samples, num_samples, MPI_BYTE, samples, counts, displs, 
+		    MPI_BYTE, comm);
+	    pivot = weighted_median(samples, num_candidates / value_weight_size);
+	    delete [] samples;
+	    delete [] displs;
+	    delete [] counts;
+	    break;
+	}
+	case PIVOT_EXACT: {
+	    // Distributed selection of the element of rank (total+1)/2 of the
+	    // sub-hypercube: list[first ... last-1] of every process holds the
+	    // candidates; each round counts the elements before and up to the
+	    // weighted median m of the medians of all candidate ranges, and
+	    // discards all candidates on the wrong side of m (at least a
+	    // quarter of all candidates)
+	    long long count[3], total[3];	// {elements before m, up to m,
+	    					//  all elements}
+	    long long target;
+	    int first = 0, last = list_size;
+	    Value_Weight<Key> my_median;
+	    Value_Weight<Key> * medians = new Value_Weight<Key>[sub_hypercube_size];
+	    count[2] = list_size;
+	    MPI_Allreduce(&count[2], &total[2], 1, MPI_LONG_LONG, MPI_SUM, comm);
+	    target = (total[2]+1) / 2;
+	    while (total[2] > 0) {
+		my_median.value = (first < last) ? list[(first+last)/2] : Key();
+		my_median.weight = last-first;
+		MPI_Allgather(&my_median, value_weight_size, MPI_BYTE,
+			medians, value_weight_size, MPI_BYTE, comm);
+		pivot = weighted_median(medians, sub_hypercube_size);
+		count[0] = std::lower_bound(list, list + list_size, pivot, comp) - list;
+		count[1] = std::upper_bound(list, list + list_size, pivot, comp) - list;
+		MPI_Allreduce(count, total, 2, MPI_LONG_LONG, MPI_SUM, comm);
+		if (total[1] < target) {
+		    first = (int) count[1];	// Median comes after pivot
+		} else if (total[0] >= target) {
+		    last = (int) count[0];	// Median comes before pivot
+		} else {
+		    break;			// Pivot is the median
+		}
+	    }
+	    delete [] medians;
+	    break;
+	}
+	case PIVOT_MEAN:
+	default: {
+	    // Mean of medians of non-empty local lists; summed as long double
+	    // to avoid overflow (exact for 32-bit keys)
+	    long double my_median[2] = {(list_size > 0) ? Key_Traits<Key>::value(list[list_size/2]) : 0,
+		(long double) ((list_size > 0) ? 1 : 0)};
+	    long double sum[2];
+	    MPI_Allreduce(my_median, sum, 2, MPI_LONG_DOUBLE, MPI_SUM, comm);
+	    pivot = Key_Traits<Key>::make((sum[1] > 0) ? (long long) (sum[0]/sum[1]) : 0, 0);
+	    break;
+	}
+    }
+    return pivot;
+}
+
+// Load report of the distributed list
+// Output:
+//   min_size, max_size	- smallest and largest local list size
+//   mean, stddev	- mean and standard deviation of local list sizes
+//   imbalance		- largest local list size divided by the mean local 
+//   			  list size (1 for a perfectly balanced list)
+//
+template <class Key, class Compare>
+double Distributed_List_Class<Key, Compare>::load_report(double * min_size, double * max_size, 
+	double * mean, double * stddev) {
+    double my_size[2] = {(double) list_size, -(double) list_size};	// {size, -size}
+    double my_sums[2] = {(double) list_size, (double) list_size * list_size};	// {size, size^2}
+    double extremes[2], sums[2];
+    MPI_Allreduce(my_size, extremes, 2, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    MPI_Allreduce(my_sums, sums, 2, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    *max_size = extremes[0];
+    *min_size = -extremes[1];
+    *mean = sums[0] / num_procs;
+    *stddev = sums[1] / num_procs - (*mean) * (*mean);
+    *stddev = (*stddev > 0) ? sqrt(*stddev) : 0;
+    return (sums[0] > 0) ? *max_size / *mean : 1.0;
+}
+
+// Rebalance the sorted list: moves elements between processes such that 
+// every process holds ceil(N/p) elements of the sorted list (the last 
+// processes may hold fewer), N being the total number of elements. Global 
+// order is preserved: process r receives the elements at global positions 
+// r*ceil(N/p) ... (r+1)*ceil(N/p)-1. The global position of the local list
+// is computed by MPI_Exscan; only slices that cross a target range boundary
+// are sent to other processes.
+//
+template <class Key, class Compare>
+void Distributed_List_Class<Key, Compare>::rebalance() {
+    long long my_size = list_size, my_first = 0, total;
+    long long target_size, first, last;
+    int * send_counts = new int[num_procs];
+    int * send_displs = new int[num_procs];
+    int * recv_counts = new int[num_procs];
+    int * recv_displs = new int[num_procs];
+    int i, recv_size;
+
+    // Global position of list[0] and total number of elements
+    MPI_Exscan(&my_size, &my_first, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    if (my_id == 0) my_first = 0;
+    MPI_Allreduce(&my_size, &total, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    target_size = (total + num_procs-1) / num_procs;
+
+    // Part of local list in the target range of process i
+    for (i = 0; i < num_procs; i++) {
+	first = std::max(my_first, std::min((long long) i * target_size, total));
+	last = std::min(my_first + my_size, std::min((long long) (i+1) * target_size, total));
+	send_displs[i] = (int) (std::min(first, my_first + my_size) - my_first);
+	send_counts[i] = (last > first) ? (int) (last - first) : 0;
+    }
+
+    // Exchange counts, then elements; parts are received in rank order, so 
+    // the received list is sorted
+    MPI_Alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT, MPI_COMM_WORLD);
+    recv_size = 0;
+    for (i = 0; i < num_procs; i++) {
+	recv_displs[i] = recv_size;
+	recv_size += recv_counts[i];
+    }
+    reserve(scratch, scratch_capacity, recv_size, 0);
+    MPI_Alltoallv(list, send_counts, send_displs, key_type, 
+	    scratch, recv_counts, recv_displs, key_type, MPI_COMM_WORLD);
+
+    // Received list becomes the local list
+    Key * tmp = list; list = scratch; scratch = tmp;
+    int tmp_capacity = list_capacity; list_capacity = scratch_capacity; scratch_capacity = tmp_capacity;
+    list_size = recv_size;
+
+    delete [] recv_displs;
+    delete [] recv_counts;
+    delete [] send_displs;
+    delete [] send_counts;
+}
+
 //
 // HyperCube Quicksort
 //
-void HyperCube_Class::HyperCube_QuickSort() {
+template <class Key, class Compare>
+void HyperCube_Class<Key, Compare>::HyperCube_QuickSort() {
     int k; 			// Sub hypercube dimension
     int nbr_k; 			// Neighbor of this process along dim-k
 
-    int local_median;		// Median of local list
-    int pivot;			// Value used to split local list 
+    Key pivot;			// Value used to split local list 
     int idx;			// index where local list is split
     int list_size_leq;		// Number of elements <= pivot
     int list_size_gt;		// Number of elements > pivot
-    int * nbr_list; 		// Sublist received from nbr process
-    int nbr_list_size;		// nbr_list size
-    int * new_list; 		// List obtained by merging nbr list with
-    // MPI variables
-    int tag = 0;
-    MPI_Status status; 
-
-    int error, mask, i;		// Miscellaneous work variables
-
-    // Hypercube group and communicator variables to facilitate pivot computation
-    // An MPI Group and an MPI communicator are created for hypercube of 
-    // dimension k; this hypercube includes all processes with ranks 
-    // that differ from this process in the lowest k bits only
-    //
-    int sub_hypercube_size; 		// Number of processors in dim-k hypercube
-    int * sub_hypercube_processors;	// List of processors in dim-k hypercube
-    MPI_Group sub_hypercube_group; 	// Group of processes in dim-k hypercube
-    MPI_Comm sub_hypercube_comm;	// Communicator for dim-k hypercube
-    MPI_Group hypercube_group;		// Group of all processes
 
     // Sort local list
-    qsort(list, list_size, sizeof(int), compare_int);
-
-    // Initialize processor group for hypercube
-    MPI_Comm_group(MPI_COMM_WORLD, &hypercube_group);
+    this->sort_local_list();
 
     // Hypercube Quicksort
     for (k = dimension; k > 0; k--) {
 
-	// Find processes that make up the sub-hypercube of dimension k and 
-	// include this process; the sub-hypercube includes all processes with 
-	// ranks that differ from this process in the lowest k bits only 
-	sub_hypercube_size = (int) pow(2,k); mask = (~0) << k;
-	sub_hypercube_processors = new int[sub_hypercube_size]; 
-	sub_hypercube_processors[0] = my_id & mask; 
-	for (i = 1; i < sub_hypercube_size; i++) {
-	    sub_hypercube_processors[i] = sub_hypercube_processors[i-1]+1;
-	}
-
-	// Construct processor group for sub-hypercube
-	MPI_Group_incl(hypercube_group, sub_hypercube_size, sub_hypercube_processors, &sub_hypercube_group);
-
-	// Construct processor communicator to simplify computation of pivot
-	// via MPI_Allreduce within the sub-hypercube 
-	MPI_Comm_create(MPI_COMM_WORLD, sub_hypercube_group, &sub_hypercube_comm);
-
-	// Find median of sorted local list
-	local_median = list[list_size/2];
-
-	// MPI-1: Compute pivot for hypercube of dimension k (pivot = mean of medians)
-	// MPI_Allreduce can be used with the MPI Communicator sub_hypercube_comm to 
-	// compute the sum of local_median values on processes of this hypercube
+	// Compute pivot for hypercube of dimension k; the sub-hypercube of 
+	// dimension k that includes this process has communicator 
+	// sub_hypercube_comm[k] (see Initialize)
+	pivot = select_pivot(k);
 
-	// ***** Add MPI call here *****
-	MPI_Allreduce(&local_median, &pivot, 1, MPI_INT, MPI_SUM, sub_hypercube_comm);
-
-	pivot = pivot/sub_hypercube_size;
-
-	// Search for smallest element in list which is larger than pivot
+	// Search for first element in list which comes after pivot
 	// Upon return:
 	//   list[0 ... idx-1] <= pivot
 	//   list[idx ... list_size-1] > pivot
+	// (in key order, i.e. >= and < for descending order)
 	idx = split_list_index(list, list_size, pivot);
 
 	list_size_leq = idx;
@@ -314,99 +1105,399 @@ void HyperCube_Class::HyperCube_QuickSort() {
 	nbr_k = neighbor_along_dim_k(k); 
 
 	if (nbr_k > my_id) {
-	    // MPI-2: Send number of elements greater than pivot
-
-	    // ***** Add MPI call here *****
-		MPI_Send(&list_size_gt, 1, MPI_INT, nbr_k, tag, MPI_COMM_WORLD);
-
-	    // MPI-3: Receive number of elements less than or equal to pivot
+	    // Send list[idx ... list_size-1] (elements greater than pivot) to 
+	    // neighbor, receive neighbor's list of elements that are less than 
+	    // or equal to pivot and merge it with list[0 ... idx-1]
+	    exchange_merged_list(nbr_k, idx, list_size_gt, 0, list_size_leq);
+	} else {
+	    // Send list[0 ... idx-1] (elements less than or equal to pivot) to
+	    // neighbor, receive neighbor's list of elements that are greater 
+	    // than pivot and merge it with list[idx ... list_size-1]
+	    exchange_merged_list(nbr_k, 0, list_size_leq, idx, list_size_gt);
+	}
+    }
+}
 
-	    // ***** Add MPI call here *****
-		MPI_Recv(&nbr_list_size, 1, MPI_INT, nbr_k, tag, MPI_COMM_WORLD, &status);
+// Select splitters from regular samples of the sorted local lists
+// Output:
+//   splitters	- num_procs-1 splitters in key order; process i receives
+//   		  the elements that come after splitters[i-1] and not after
+//   		  splitters[i]
+//
+template <class Key, class Compare>
+void SampleSort_Class<Key, Compare>::select_splitters(Key * splitters) {
+    int i;
+    Key * my_samples = new Key[num_procs];
+    Key * samples = new Key[num_procs*num_procs];
+
+    // num_procs regular samples of local list, at the i/num_procs quantiles
+    // (list_size > 0 since the initial list size is at least 1)
+    for (i = 0; i < num_procs; i++) {
+	my_samples[i] = list[(int) (((long long) i * list_size) / num_procs)];
+    }
+    MPI_Allgather(my_samples, num_procs, key_type, samples, num_procs, key_type, MPI_COMM_WORLD);
+
+    // Each sample stands for list_size/num_procs elements, so sorted 
+    // sample i*num_procs estimates the i/num_procs quantile of the list 
+    // (the element with global rank i*list_size); it is splitter i-1
+    std::sort(samples, samples + num_procs*num_procs, comp);
+    for (i = 1; i < num_procs; i++) {
+	splitters[i-1] = samples[i*num_procs];
+    }
 
+    delete [] samples;
+    delete [] my_samples;
+}
 
-	    // Allocate storage for neighbor's list
-	    nbr_list = new int[nbr_list_size];
+// Move run heap[i] down the min-heap heap[0 ... heap_size-1] of runs, which
+// is ordered (by comp) by the next element runs[next[r]] of each run r
+//
+template <class Key, class Compare>
+static void sift_down(int * heap, int heap_size, int i, Key * runs, int * next, Compare & comp) {
+    int r = heap[i];
+    int child;
+    while ((child = 2*i+1) < heap_size) {
+	if ((child+1 < heap_size) && comp(runs[next[heap[child+1]]], runs[next[heap[child]]])) child++;
+	if (!comp(runs[next[heap[child]]], runs[next[r]])) break;
+	heap[i] = heap[child]; 
+	i = child;
+    }
+    heap[i] = r;
+}
 
-	    // MPI-4: Send list[idx ... list_size-1] to neighbor
+// Merge k sorted runs
+// Input:
+//   runs		- runs[displs[r] ... displs[r]+counts[r]-1] is run r
+//   displs, counts	- offset and size of each run
+//   k			- number of runs
+// Output:
+//   out		- merged list of size counts[0]+...+counts[k-1]
+//
+template <class Key, class Compare>
+void SampleSort_Class<Key, Compare>::kway_merge(Key * runs, int * displs, int * counts, int k, Key * out) {
+    int * heap = new int[k];	// Min-heap of non-empty runs
+    int * next = new int[k];	// Index of next element of each run
+    int * last = new int[k];	// Index after last element of each run
+    int heap_size = 0;
+    int i, r, idx = 0;
+
+    for (r = 0; r < k; r++) {
+	next[r] = displs[r];
+	last[r] = displs[r] + counts[r];
+	if (counts[r] > 0) heap[heap_size++] = r;
+    }
+    for (i = heap_size/2-1; i >= 0; i--) {
+	sift_down(heap, heap_size, i, runs, next, comp);
+    }
 
-	    // ***** Add MPI call here *****
-		MPI_Send(&list[idx], list_size_gt, MPI_INT, nbr_k, tag, MPI_COMM_WORLD);
+    // Repeatedly move first element (in key order) of all runs to out
+    while (heap_size > 0) {
+	r = heap[0];
+	out[idx++] = runs[next[r]++];
+	if (next[r] == last[r]) {
+	    heap[0] = heap[--heap_size];	// Run r is exhausted
+	}
+	sift_down(heap, heap_size, 0, runs, next, comp);
+    }
 
+    delete [] last;
+    delete [] next;
+    delete [] heap;
+}
 
-	    // MPI-5: Receive neighbor's list of elements that are less than or equal to pivot
+//
+// Parallel Sorting by Regular Sampling
+//
+template <class Key, class Compare>
+void SampleSort_Class<Key, Compare>::SampleSort() {
+    int i;
+    Key * splitters = new Key[num_procs];
+    int * send_counts = new int[num_procs];
+    int * send_displs = new int[num_procs];
+    int * recv_counts = new int[num_procs];
+    int * recv_displs = new int[num_procs];
+    int recv_size;
 
-	    // ***** Add MPI call here *****
-		MPI_Recv(nbr_list, nbr_list_size, MPI_INT, nbr_k, tag, MPI_COMM_WORLD, &status);
+    // Sort local list
+    this->sort_local_list();
 
+    select_splitters(splitters);
 
-	    // Merge local list of elements less than or equal to pivot with neighbor's list
-	    new_list = merged_list(list, idx, nbr_list, nbr_list_size); 
+    // Elements of list after splitters[i-1] and up to splitters[i] are sent 
+    // to process i; the local list is sorted, so each part is contiguous
+    send_displs[0] = 0;
+    for (i = 1; i < num_procs; i++) {
+	send_displs[i] = split_list_index(list, list_size, splitters[i-1]);
+	if (send_displs[i] < send_displs[i-1]) send_displs[i] = send_displs[i-1];
+	send_counts[i-1] = send_displs[i] - send_displs[i-1];
+    }
+    send_counts[num_procs-1] = list_size - send_displs[num_procs-1];
+
+    // Exchange counts, then all elements in one exchange
+    MPI_Alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT, MPI_COMM_WORLD);
+    recv_size = 0;
+    for (i = 0; i < num_procs; i++) {
+	recv_displs[i] = recv_size;
+	recv_size += recv_counts[i];
+    }
+    reserve(scratch, scratch_capacity, recv_size, 0);
+    MPI_Alltoallv(list, send_counts, send_displs, key_type, 
+	    scratch, recv_counts, recv_displs, key_type, MPI_COMM_WORLD);
+
+    // Merge the sorted runs received from all processes into list
+    reserve(list, list_capacity, recv_size, 0);
+    kway_merge(scratch, recv_displs, recv_counts, num_procs, list);
+    list_size = recv_size;
+
+    delete [] recv_displs;
+    delete [] recv_counts;
+    delete [] send_displs;
+    delete [] send_counts;
+    delete [] splitters;
+}
 
-	    // Replace local list with new_list, update size
-	    delete [] list; 
-	    delete [] nbr_list; 
-	    list = new_list; 
-	    list_size = list_size_leq+nbr_list_size;
+// Create and initialize the sorter of the selected algorithm for keys of
+// type Key in the order given by Compare
+// Input:
+//   algorithm		- ALGORITHM_HYPERCUBE or ALGORITHM_SAMPLE
+//   dim		- hypercube dimension (ALGORITHM_HYPERCUBE)
+//   size, type		- local list size and initialization type
+//   pivot_strategy	- hypercube quicksort pivot selection
+//
+template <class Key, class Compare>
+Distributed_List_Class<Key, Compare> * new_sorter(int algorithm, int dim, int size, int type,
+	int pivot_strategy) {
+    if (algorithm == ALGORITHM_HYPERCUBE) {
+	HyperCube_Class<Key, Compare> * HyperCube = new HyperCube_Class<Key, Compare>;
+	HyperCube->Initialize(dim, size, type);	// Initialize Hypercube node
+	HyperCube->pivot_strategy = pivot_strategy;
+	return HyperCube;
+    } else {
+	SampleSort_Class<Key, Compare> * SampleSort = new SampleSort_Class<Key, Compare>;
+	SampleSort->Initialize(size, type);	// Initialize Sample Sort node
+	return SampleSort;
+    }
+}
 
+// Print timing results of a sort on process 0
+//
+template <class Key, class Compare>
+void print_results(Distributed_List_Class<Key, Compare> * sorter, int algorithm, int pivot_strategy,
+	int num_threads, const char * type_name, int order, double total_time) {
+    double min_size, max_size, mean_size, stddev_size;
+    double imbalance = sorter->load_report(&min_size, &max_size, &mean_size, &stddev_size);
+    if (sorter->my_id == 0) {
+	printf("[Proc: %0d] number of processes = %d, ", sorter->my_id, sorter->num_procs);
+	printf("threads per process = %d, ", num_threads);
+	printf("initial local list size = %d, ", sorter->list_size_initial);
+	printf("list type = %s, ", type_name);
+	printf("keys = %s %s, ", Key_Traits<Key>::name(), order_names[order]);
+	if (algorithm == ALGORITHM_HYPERCUBE) {
+	    printf("pivot = %s, ", pivot_names[pivot_strategy]);
+	    printf("hypercube quicksort time = %f, ", total_time);
 	} else {
-	    // MPI-6: Receive number of elements greater than pivot
+	    printf("sample sort time = %f, ", total_time);
+	}
+	printf("load imbalance (max/mean) = %.3f\n", imbalance);
+	printf("[Proc: %0d] final local list size: min = %.0f, max = %.0f, mean = %.1f, stddev = %.1f\n", 
+		sorter->my_id, min_size, max_size, mean_size, stddev_size);
+    }
+}
 
-	    // ***** Add MPI call here *****
-		MPI_Recv(&nbr_list_size, 1, MPI_INT, nbr_k, tag, MPI_COMM_WORLD, &status);
+// Rebalance the sorted list (see Distributed_List_Class::rebalance) and 
+// print the time of the rebalance pass and the resulting load on process 0
+//
+template <class Key, class Compare>
+void rebalance_list(Distributed_List_Class<Key, Compare> * sorter) {
+    double start, rebalance_time;
+    double min_size, max_size, mean_size, stddev_size, imbalance;
+    start = MPI_Wtime();
+    sorter->rebalance();
+    rebalance_time = MPI_Wtime()-start;
+    imbalance = sorter->load_report(&min_size, &max_size, &mean_size, &stddev_size);
+    if (sorter->my_id == 0) {
+	printf("[Proc: %0d] rebalance time = %f, ", sorter->my_id, rebalance_time);
+	printf("final local list size: min = %.0f, max = %.0f, ", min_size, max_size);
+	printf("load imbalance (max/mean) = %.3f\n", imbalance);
+    }
+}
 
-	    // MPI-7: Send number of elements less than or equal to pivot
+// Create, run and verify the sorter of the selected algorithm for keys of
+// type Key in the order given by Compare; prints timing results on
+// process 0
+// Input:
+//   algorithm		- ALGORITHM_HYPERCUBE or ALGORITHM_SAMPLE
+//   dim		- hypercube dimension (ALGORITHM_HYPERCUBE)
+//   size, type		- local list size and initialization type
+//   pivot_strategy	- hypercube quicksort pivot selection
+//   num_threads	- OpenMP threads per process
+//   type_name, order	- list type as given by the user and key order
+//   			  (for output)
+//   rebalance		- rebalance sorted list (timed separately)
+//
+template <class Key, class Compare>
+void sort_distributed_list(int algorithm, int dim, int size, int type, int pivot_strategy,
+	int num_threads, const char * type_name, int order, int rebalance) {
+    double start, total_time;		// Timing variables
 
-	    // ***** Add MPI call here *****
-		MPI_Send(&list_size_leq, 1, MPI_INT, nbr_k, tag, MPI_COMM_WORLD);
-		
-	    // Allocate storage for neighbor's list
-	    nbr_list = new int[nbr_list_size]; 
+    // Hypercube/Sample Sort Initializations +++++++++++++++++++++++++++++++
+    Distributed_List_Class<Key, Compare> * sorter = 
+	new_sorter<Key, Compare>(algorithm, dim, size, type, pivot_strategy);
 
-	    // MPI-8: Receive neighbor's list of elements that are greater than the pivot
+    if (VERBOSE > 2) {
+	sorter->print_list();
+    }
 
-	    // ***** Add MPI call here *****
-		MPI_Recv(nbr_list, nbr_list_size, MPI_INT, nbr_k, tag, MPI_COMM_WORLD, &status);
+    // Start Sort ...........................................................
+    start = MPI_Wtime();
+    sorter->Sort();
+    total_time = MPI_Wtime()-start;
+    // End Sort .............................................................
 
-	    // MPI-9: Send list[0 ... idx-1] to neighbor
+    print_results(sorter, algorithm, pivot_strategy, num_threads, type_name, order, total_time);
 
-	    // ***** Add MPI call here *****
-		MPI_Send(list, list_size_leq, MPI_INT, nbr_k, tag, MPI_COMM_WORLD);
+    if (rebalance) {
+	rebalance_list(sorter);
+    }
 
-	    // Merge local list of elements greater than pivot with neighbor's list
-	    new_list = merged_list(&list[idx], list_size_gt, nbr_list, nbr_list_size); 
+    // Check if list has been sorted correctly
+    sorter->check_list();
 
-	    // Replace local list with new_list, update size
-	    delete [] list; 
-	    delete [] nbr_list; 
-	    list = new_list; 
-	    list_size = list_size_gt+nbr_list_size;
-	}
-	// Deallocate processor group, processor communicator, 
-	// sub_hypercube_processors array; these variables will be 
-	// reused in the next iteration of this for loop for a hypercube of 
-	// dimension (k-1)
-	MPI_Group_free(&sub_hypercube_group);
-	MPI_Comm_free(&sub_hypercube_comm);
-	delete [] sub_hypercube_processors;
+    if (VERBOSE > 2) {
+	sorter->print_list();
     }
+
+    sorter->Finalize();
+    delete sorter;
 }
 
-// Comparison routine for qsort (stdlib.h) which is used to sort local list 
-// Used as follows to sort elements of list[0 ... list_size-1]: 
+// Move records to the positions of their tuples in the sorted list of 
+// tuples. Every process requests the records of its tuples from their 
+// origin processes (one all-to-all of record indices), and the origin 
+// processes send the records (one all-to-all of records).
+// Input:
+//   tuples, num_tuples	- sorted local list of tuples
+//   records, size	- initial local list of records; record j of process
+//   			  i has origin i*size+j
+// Output:
+//   sorted_records	- sorted_records[j] is the record of tuples[j]
 //
-// 	qsort(list, list_size, sizeof(int), compare_int)
+void move_records(Tuple * tuples, int num_tuples, Record * records, int size, 
+	Record * sorted_records) {
+    int num_procs, i, j;
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+    int * request_counts = new int[num_procs];	// Records requested from each process
+    int * request_displs = new int[num_procs];
+    int * reply_counts = new int[num_procs];	// Records requested by each process
+    int * reply_displs = new int[num_procs];
+    int * request_index = new int[num_tuples];	// Requests, grouped by origin process
+    int * request_slot = new int[num_tuples];	// Position of requested record in sorted_records
+    int num_replies;
+
+    // Group requests by origin process (counting sort)
+    for (i = 0; i < num_procs; i++) request_counts[i] = 0;
+    for (j = 0; j < num_tuples; j++) request_counts[tuples[j].origin / size]++;
+    request_displs[0] = 0;
+    for (i = 1; i < num_procs; i++) request_displs[i] = request_displs[i-1] + request_counts[i-1];
+    for (j = 0; j < num_tuples; j++) {
+	i = (int) (tuples[j].origin / size);
+	request_index[request_displs[i]] = (int) (tuples[j].origin % size);
+	request_slot[request_displs[i]] = j;
+	request_displs[i]++;
+    }
+    for (i = 0; i < num_procs; i++) request_displs[i] -= request_counts[i];
+
+    // Send indices of requested records to their origin processes
+    MPI_Alltoall(request_counts, 1, MPI_INT, reply_counts, 1, MPI_INT, MPI_COMM_WORLD);
+    num_replies = 0;
+    for (i = 0; i < num_procs; i++) {
+	reply_displs[i] = num_replies;
+	num_replies += reply_counts[i];
+    }
+    int * reply_index = new int[num_replies];
+    MPI_Alltoallv(request_index, request_counts, request_displs, MPI_INT, 
+	    reply_index, reply_counts, reply_displs, MPI_INT, MPI_COMM_WORLD);
+
+    // Send requested records; each record crosses the network once
+    Record * replies = new Record[num_replies];
+    Record * received = new Record[num_tuples];
+    for (j = 0; j < num_replies; j++) replies[j] = records[reply_index[j]];
+    MPI_Alltoallv(replies, reply_counts, reply_displs, Key_Traits<Record>::mpi_type(), 
+	    received, request_counts, request_displs, Key_Traits<Record>::mpi_type(), MPI_COMM_WORLD);
+    for (j = 0; j < num_tuples; j++) sorted_records[request_slot[j]] = received[j];
+
+    delete [] received;
+    delete [] replies;
+    delete [] reply_index;
+    delete [] request_slot;
+    delete [] request_index;
+    delete [] reply_displs;
+    delete [] reply_counts;
+    delete [] request_displs;
+    delete [] request_counts;
+}
+
+// Key-only sort of records: sorts (key, origin) tuples with the selected
+// algorithm (and rebalances them), then moves the records with 
+// move_records; prints timing results on process 0 and verifies the records
+// Input: see sort_distributed_list
 //
-int compare_int(const void *a0, const void *b0) {
-    int a = *(int *)a0;
-    int b = *(int *)b0;
-    if (a < b) {
-	return -1; 
-    } else if (a > b) {
-	return 1;
-    } else {
-	return 0;
+template <class Compare>
+void sort_records_by_key(int algorithm, int dim, int size, int type, int pivot_strategy,
+	int num_threads, const char * type_name, int order, int rebalance) {
+    double start, total_time, move_time;	// Timing variables
+    int j, error, local_error;
+
+    Distributed_List_Class<Tuple, Compare> * sorter = 
+	new_sorter<Tuple, Compare>(algorithm, dim, size, type, pivot_strategy);
+
+    // Records of the initial list: same keys and origins as the tuples
+    Record * records = new Record[size];
+    Tuple * tuples = sorter->local_list();
+    for (j = 0; j < size; j++) {
+	records[j] = Key_Traits<Record>::make(tuples[j].key, tuples[j].origin);
+    }
+
+    // Start Sort ...........................................................
+    start = MPI_Wtime();
+    sorter->Sort();
+    total_time = MPI_Wtime()-start;
+    print_results(sorter, algorithm, pivot_strategy, num_threads, type_name, order, total_time);
+    if (rebalance) {
+	rebalance_list(sorter);
+    }
+    move_time = MPI_Wtime();
+    Record * sorted_records = new Record[sorter->list_size];
+    move_records(sorter->local_list(), sorter->list_size, records, size, sorted_records);
+    move_time = MPI_Wtime()-move_time;
+    // End Sort .............................................................
+
+    if (sorter->my_id == 0) {
+	printf("[Proc: %0d] record move time = %f\n", sorter->my_id, move_time);
+    }
+
+    // Check if tuples have been sorted correctly and records have been 
+    // moved to the positions of their tuples
+    sorter->check_list();
+    tuples = sorter->local_list();
+    local_error = 0;
+    for (j = 0; j < sorter->list_size; j++) {
+	if ((sorted_records[j].key != tuples[j].key) || (sorted_records[j].origin != tuples[j].origin) 
+		|| !Key_Traits<Record>::intact(sorted_records[j])) local_error = 1;
     }
+    MPI_Reduce(&local_error, &error, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (sorter->my_id == 0) {
+	if (error == 0) {
+	    printf("[Proc: %0d] Congratulations. The records have been moved correctly.\n", sorter->my_id);
+	} else {
+	    printf("[Proc: %0d] Error encountered. The records have not been moved correctly.\n", sorter->my_id);
+	}
+    }
+
+    delete [] sorted_records;
+    delete [] records;
+    sorter->Finalize();
+    delete sorter;
 }
 
 //------------------------------------------------------------------------------
@@ -417,22 +1508,81 @@ int main(int argc, char *argv[])
     // User inputs
     int size; 				// List size on each process
     int type;				// type for list initialization
+    int pivot_strategy = PIVOT_MEAN;	// Pivot selection strategy
+    int algorithm = ALGORITHM_HYPERCUBE;// Sorting algorithm
+    int num_threads = 0;		// OpenMP threads per process (0: default)
+    int key = KEY_INT;			// Key type
+    int rebalance = 0;			// Rebalance sorted list
+    int order = ORDER_ASCENDING;	// Key order
+    int opt;
     int dim;				// Hypercube dimension 
 
     // MPI 
     int my_id; 				// My MPI rank
     int num_procs;			// Hypercube size 
-    double start, total_time;		// Timing variables
+    int provided;			// Thread support provided by MPI
 
-    // MPI
-    MPI_Init(&argc,&argv);		// Initialize MPI
+    // MPI; only the master thread makes MPI calls
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
     MPI_Comm_size(MPI_COMM_WORLD,&num_procs);	// num_procs = number of processes
     MPI_Comm_rank(MPI_COMM_WORLD,&my_id);	// my_id = rank of this process
 
     //  Check inputs
-    if (argc != 3)  {
-	if (my_id == 0) 
-	    printf("Usage: mpirun -np <number_of_processes> <executable_name> <list_size_per_process> <type>\n");
+    //  Options precede the positional arguments ("+": stop at the first 
+    //  non-option, so a negative type is not taken for an option)
+    while ((opt = getopt(argc, argv, "+a:bk:o:p:t:")) != -1) {
+	switch (opt) {
+	    case 'a':
+		for (algorithm = ALGORITHM_SAMPLE; algorithm >= 0; algorithm--) {
+		    if (strcmp(optarg, algorithm_names[algorithm]) == 0) break;
+		}
+		if (algorithm >= 0) break;
+		argc = -1;
+		break;
+	    case 'b':
+		rebalance = 1;
+		break;
+	    case 'k':
+		for (key = KEY_TUPLE; key >= 0; key--) {
+		    if (strcmp(optarg, key_names[key]) == 0) break;
+		}
+		if (key >= 0) break;
+		argc = -1;
+		break;
+	    case 'o':
+		for (order = ORDER_DESCENDING; order >= 0; order--) {
+		    if (strcmp(optarg, order_names[order]) == 0) break;
+		}
+		if (order >= 0) break;
+		argc = -1;
+		break;
+	    case 'p':
+		for (pivot_strategy = PIVOT_EXACT; pivot_strategy >= 0; pivot_strategy--) {
+		    if (strcmp(optarg, pivot_names[pivot_strategy]) == 0) break;
+		}
+		if (pivot_strategy >= 0) break;
+		argc = -1;
+		break;
+	    case 't':
+		if ((num_threads = atoi(optarg)) > 0) break;
+		argc = -1;
+		break;
+	    default:
+		argc = -1;
+	}
+    }
+    if (argc-optind != 2)  {
+	if (my_id == 0) {
+	    printf("Usage: mpirun -np <number_of_processes> <executable_name> [-a hypercube|sample] [-b] [-k 32|64|record|tuple] [-o ascending|descending] [-p mean|wmedian|sample|exact] [-t threads] <list_size_per_process> <type>\n");
+	    printf("       -a: hypercube quicksort (power of 2 processes, default) or sample sort (any number of processes)\n");
+	    printf("       -b: rebalance sorted list (equal local list sizes)\n");
+	    printf("       -k: 32- or 64-bit keys (default 32), records, or records sorted as (key, origin) tuples\n");
+	    printf("       -o: key order (default ascending)\n");
+	    printf("       -p: hypercube quicksort pivot\n");
+	    printf("       -t: OpenMP threads per process (if compiled with OpenMP)\n");
+	    printf("       <type>: -1 (descending), -2 (ascending), seed >= 0 (random), or one of: ");
+	    print_dist_names();
+	}
 	exit(0);
     }
 
@@ -443,42 +1593,74 @@ int main(int argc, char *argv[])
 	exit(0);
     }
 
-    type = atoi(argv[argc-1]);
+    // Distributions are selected by name only; numeric types below -2 are
+    // rejected so they cannot alias a TYPE_DIST value
+    char * type_end;
+    int dist = dist_from_name(argv[argc-1]);
+    if (dist >= 0) {
+	type = TYPE_DIST(dist);
+    } else {
+	type = (int) strtol(argv[argc-1], &type_end, 10);
+    }
+    if ((dist < 0) && ((type < -2) || (type_end == argv[argc-1]) || (*type_end != '\0'))) {
+	if (my_id == 0)
+	    printf("Unknown list initialization type: %s. Aborting ...\n", argv[argc-1]);
+	exit(0);
+    }
 
     // Compute hypercube dimension: 2^dim = num_procs
     dim = (int) log2((double) num_procs); 
-    if (num_procs != (int) pow(2,dim)) {
+    if ((algorithm == ALGORITHM_HYPERCUBE) && (num_procs != (int) pow(2,dim))) {
 	if (my_id == 0) 
-	    printf("Number of processors must be power of 2. Aborting ...\n"); 
+	    printf("Number of processors must be power of 2 (or use -a sample). Aborting ...\n"); 
 	exit(0); 
     }
 
-    // Hypercube Initializations +++++++++++++++++++++++++++++++++++++++++++
-
-    HyperCube_Class HyperCube; 			// Create Hypercube node
-    HyperCube.Initialize(dim, size, type);	// Initialize Hypercube node
-
-    if (VERBOSE > 2) {
-	HyperCube.print_list();
-    }
-
-    // Start Hypercube Quicksort ..............................................
-    start = MPI_Wtime(); 
-    HyperCube.HyperCube_QuickSort(); 
-    total_time = MPI_Wtime()-start;
-    // End Hypercube Quicksort ..............................................
-
-    if (my_id == 0) {
-	printf("[Proc: %0d] number of processes = %d, ", HyperCube.my_id, HyperCube.num_procs);
-	printf("initial local list size = %d, ", HyperCube.list_size_initial);
-	printf("hypercube quicksort time = %f\n", total_time); 
+#ifdef _OPENMP
+    if (provided < MPI_THREAD_FUNNELED) {
+	if (my_id == 0) 
+	    printf("MPI_THREAD_FUNNELED not supported; using 1 thread per process\n"); 
+	num_threads = 1;
     }
+    if (num_threads > 0) omp_set_num_threads(num_threads);
+    num_threads = omp_get_max_threads();
+#else
+    num_threads = 1;
+#endif
 
-    // Check if list has been sorted correctly
-    HyperCube.check_list();
-
-    if (VERBOSE > 2) {
-	HyperCube.print_list();
+    // Sort with the specialization for the selected key type and order
+    if (key == KEY_INT) {
+	if (order == ORDER_ASCENDING) {
+	    sort_distributed_list<int, std::less<int> >(algorithm, dim, size, type,
+		    pivot_strategy, num_threads, argv[argc-1], order, rebalance);
+	} else {
+	    sort_distributed_list<int, std::greater<int> >(algorithm, dim, size, type,
+		    pivot_strategy, num_threads, argv[argc-1], order, rebalance);
+	}
+    } else if (key == KEY_LONG) {
+	if (order == ORDER_ASCENDING) {
+	    sort_distributed_list<long long, std::less<long long> >(algorithm, dim, size, type,
+		    pivot_strategy, num_threads, argv[argc-1], order, rebalance);
+	} else {
+	    sort_distributed_list<long long, std::greater<long long> >(algorithm, dim, size, type,
+		    pivot_strategy, num_threads, argv[argc-1], order, rebalance);
+	}
+    } else if (key == KEY_RECORD) {
+	if (order == ORDER_ASCENDING) {
+	    sort_distributed_list<Record, By_Key<std::less<long long> > >(algorithm, dim, size, type,
+		    pivot_strategy, num_threads, argv[argc-1], order, rebalance);
+	} else {
+	    sort_distributed_list<Record, By_Key<std::greater<long long> > >(algorithm, dim, size, type,
+		    pivot_strategy, num_threads, argv[argc-1], order, rebalance);
+	}
+    } else {
+	if (order == ORDER_ASCENDING) {
+	    sort_records_by_key<By_Key<std::less<long long> > >(algorithm, dim, size, type,
+		    pivot_strategy, num_threads, argv[argc-1], order, rebalance);
+	} else {
+	    sort_records_by_key<By_Key<std::greater<long long> > >(algorithm, dim, size, type,
+		    pivot_strategy, num_threads, argv[argc-1], order, rebalance);
+	}
     }
 
     MPI_Finalize();				// Finalize MPI
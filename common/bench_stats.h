@@ -0,0 +1,32 @@
+//
+// Statistics of repeated benchmark timings
+//
+#ifndef BENCH_STATS_H
+#define BENCH_STATS_H
+
+#include <stdlib.h>
+
+static inline int compare_double(const void *a0, const void *b0) {
+    double a = *(const double *)a0;
+    double b = *(const double *)b0;
+    return (a < b) ? -1 : ((a > b) ? 1 : 0);
+}
+
+// Percentile p (0 ... 100) of sorted times[0 ... n-1], by linear
+// interpolation between closest ranks
+static inline double percentile(const double *times, int n, double p) {
+    double rank = (n-1) * p / 100.0;
+    int lo = (int) rank;
+    if (lo+1 >= n) return times[n-1];
+    return times[lo] + (rank-lo) * (times[lo+1]-times[lo]);
+}
+
+// Sort times[0 ... n-1] and return its median, 10th and 90th percentile
+static inline void bench_stats(double *times, int n, double *median, double *p10, double *p90) {
+    qsort(times, n, sizeof(double), compare_double);
+    *median = percentile(times, n, 50.0);
+    *p10 = percentile(times, n, 10.0);
+    *p90 = percentile(times, n, 90.0);
+}
+
+#endif
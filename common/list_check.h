@@ -0,0 +1,57 @@
+//
+// Fast verification of sorted lists
+//
+// A list is sorted correctly if it is in ascending order and holds the same
+// multiset of keys as the input. The multiset is compared via a fingerprint:
+// the sum and the xor of a 64-bit hash of every key. Both are independent
+// of element order, so fingerprints of sub-lists can be computed in
+// parallel and combined, and no reference sort is needed.
+//
+#ifndef LIST_CHECK_H
+#define LIST_CHECK_H
+
+#include "list_init.h"
+
+typedef struct List_fingerprint {
+    unsigned long long sum;	// Sum of key hashes (mod 2^64)
+    unsigned long long xor_;	// Xor of key hashes
+} list_fingerprint;
+
+// Fingerprint of list[first ... last-1]
+static inline list_fingerprint fingerprint_range(const int *list, long long first, long long last) {
+    list_fingerprint f = {0, 0};
+    unsigned long long h;
+    long long j;
+    for (j = first; j < last; j++) {
+	h = mix64((unsigned long long) (unsigned int) list[j]);
+	f.sum += h;
+	f.xor_ ^= h;
+    }
+    return f;
+}
+
+// Combine fingerprints of two disjoint sub-lists
+static inline list_fingerprint fingerprint_combine(list_fingerprint a, list_fingerprint b) {
+    a.sum += b.sum;
+    a.xor_ ^= b.xor_;
+    return a;
+}
+
+static inline int fingerprint_equal(list_fingerprint a, list_fingerprint b) {
+    return (a.sum == b.sum) && (a.xor_ == b.xor_);
+}
+
+// Return 1 if list[first ... last-1] is not in ascending order; the pair
+// (list[last-1], list[last]) is checked too if last < list_size, so
+// adjacent ranges checked independently cover the whole list
+//
+static inline int unsorted_range(const int *list, long long first, long long last, long long list_size) {
+    long long j;
+    if (last < list_size) last++;
+    for (j = first+1; j < last; j++) {
+	if (list[j] < list[j-1]) return 1;
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,151 @@
+//
+// Input distributions used to initialize the lists sorted by the HW2, HW3
+// and HW4 sorting programs
+//
+// Every value is a pure function of (distribution, seed, global index), so a
+// list can be filled in any order, by any number of threads or processes,
+// and always comes out the same. Distributed programs pass the global offset
+// of their local list and the global list size.
+//
+// Usable from both C and C++; include with
+//
+//	#include "../common/list_init.h"
+//
+#ifndef LIST_INIT_H
+#define LIST_INIT_H
+
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+
+// Supported distributions
+enum {
+    DIST_UNIFORM = 0,	// uniform random values over the full range
+    DIST_ZIPF,		// zipf distributed ranks (s = 1.2), scattered over range
+    DIST_FEW_UNIQUE,	// random values drawn from 16 distinct keys
+    DIST_ALL_EQUAL,	// every element has the same value
+    DIST_SORTED,	// ascending
+    DIST_REVERSE,	// descending
+    DIST_ORGAN_PIPE,	// ascending up to the middle, descending afterwards
+    DIST_SAWTOOTH,	// 16 ascending runs
+    DIST_STAGGERED,	// block i draws from a range placed far from block i's
+    			// final position (Helman/Bader/JaJa "staggered" input)
+    NUM_DISTS
+};
+
+static const char *dist_names[NUM_DISTS] = {
+    "uniform", "zipf", "few_unique", "all_equal", "sorted", "reverse",
+    "organ_pipe", "sawtooth", "staggered"
+};
+
+#define ZIPF_EXPONENT		1.2
+#define ZIPF_NUM_RANKS		(1 << 20)
+#define FEW_UNIQUE_KEYS		16
+#define SAWTOOTH_TEETH		16
+
+// Return distribution id for name, or -1 if name is not a distribution
+static inline int dist_from_name(const char *name) {
+    int d;
+    for (d = 0; d < NUM_DISTS; d++) {
+        if (strcmp(name, dist_names[d]) == 0) return d;
+    }
+    return -1;
+}
+
+// Print the list of supported distributions, separated by '|'
+static inline void print_dist_names(void) {
+    int d;
+    for (d = 0; d < NUM_DISTS; d++) {
+        printf("%s%s", dist_names[d], (d+1 < NUM_DISTS) ? "|" : "\n");
+    }
+}
+
+// 64-bit mixing function (splitmix64 finalizer); used as a counter-based
+// random number generator: mix64(seed + index) is a random 64-bit value
+static inline unsigned long long mix64(unsigned long long x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Value of element idx of a list of size total, in the range [0, range)
+// Input:
+//   dist		- distribution id
+//   idx, total		- global index of element and global list size
+//   num_blocks		- number of threads/processes the list is split into
+//   			  (only used by DIST_STAGGERED)
+//   seed		- random seed
+//   range		- values are in [0, range); range > 0
+//
+static inline unsigned long long dist_value(int dist, long long idx, long long total,
+	int num_blocks, unsigned long long seed, unsigned long long range) {
+    unsigned long long r = mix64(seed * 0x2545f4914f6cdd1dULL + (unsigned long long) idx);
+    unsigned long long step = (total > 0 && range / total > 0) ? range / total : 1;
+    unsigned long long period, width, base;
+    long long block_size, blk;
+    double u, a;
+
+    switch (dist) {
+	case DIST_ZIPF:
+	    // Inverse CDF of the continuous power law on [1, ZIPF_NUM_RANKS]
+	    u = ((r >> 11) + 1) * (1.0 / 9007199254740992.0);
+	    a = 1.0 - ZIPF_EXPONENT;
+	    r = (unsigned long long) pow((pow((double) ZIPF_NUM_RANKS, a) - 1.0) * u + 1.0, 1.0 / a);
+	    return mix64(seed ^ r) % range;
+	case DIST_FEW_UNIQUE:
+	    return mix64(seed ^ (r % FEW_UNIQUE_KEYS)) % range;
+	case DIST_ALL_EQUAL:
+	    return range / 2;
+	case DIST_SORTED:
+	    return ((unsigned long long) idx * step) % range;
+	case DIST_REVERSE:
+	    return ((unsigned long long) (total-1-idx) * step) % range;
+	case DIST_ORGAN_PIPE:
+	    if (idx < total/2) return ((unsigned long long) idx * step) % range;
+	    return ((unsigned long long) (total-1-idx) * step) % range;
+	case DIST_SAWTOOTH:
+	    period = (total >= SAWTOOTH_TEETH) ? total / SAWTOOTH_TEETH : 1;
+	    step = (range / period > 0) ? range / period : 1;
+	    return (((unsigned long long) idx % period) * step) % range;
+	case DIST_STAGGERED:
+	    if (num_blocks < 1) num_blocks = 1;
+	    block_size = (total >= num_blocks) ? total / num_blocks : 1;
+	    blk = idx / block_size;
+	    if (blk >= num_blocks) blk = num_blocks-1;
+	    width = (range / num_blocks > 0) ? range / num_blocks : 1;
+	    if (blk < num_blocks/2) {
+		base = (2*blk+1) * width;
+	    } else {
+		base = (blk-num_blocks/2) * 2 * width;
+	    }
+	    return (base + r % width) % range;
+	case DIST_UNIFORM:
+	default:
+	    return r % range;
+    }
+}
+
+// Fill list[0 ... n-1] with elements offset ... offset+n-1 of a 32-bit list
+// of size total; values are non-negative (as returned by lrand48)
+//
+static inline void fill_list_int(int *list, long long n, long long offset, long long total,
+	int num_blocks, int dist, unsigned long long seed) {
+    long long j;
+    for (j = 0; j < n; j++) {
+        list[j] = (int) dist_value(dist, offset+j, total, num_blocks, seed, 1ULL << 31);
+    }
+}
+
+// Fill list[0 ... n-1] with elements offset ... offset+n-1 of a 64-bit list
+// of size total; values are non-negative
+//
+static inline void fill_list_long(long long *list, long long n, long long offset, long long total,
+	int num_blocks, int dist, unsigned long long seed) {
+    long long j;
+    for (j = 0; j < n; j++) {
+        list[j] = (long long) dist_value(dist, offset+j, total, num_blocks, seed, 1ULL << 63);
+    }
+}
+
+#endif
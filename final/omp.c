@@ -1,222 +1,407 @@
 #include <stdio.h>
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <omp.h>
 
-typedef int** Matrix;
+// Rows of every allocated matrix start on a MATRIX_ALIGNMENT byte boundary
+#define MATRIX_ALIGNMENT 64
+
+// Row-major matrix, or a view of a submatrix of one: element (row, col) is
+// data[row * stride + col]. A view shares storage with its parent, so
+// quadrants are taken without copying.
+typedef struct Matrix{
+    int* data;
+    int rows;
+    int cols;
+    int stride;     // Leading dimension: distance between rows, in elements
+} Matrix;
+
+static inline int* matrixRow(Matrix matrix, int row){
+    return matrix.data + (size_t)row * matrix.stride;
+}
 
-void printMatrix(int size, Matrix matrix){
-    for(int row = 0; row < size; row++){
-        for(int col = 0; col < size; col++){
-            printf("%d ", matrix[row][col]);
+void printMatrix(Matrix matrix){
+    for(int row = 0; row < matrix.rows; row++){
+        const int* m = matrixRow(matrix, row);
+        for(int col = 0; col < matrix.cols; col++){
+            printf("%d ", m[col]);
         }
         printf("\n");
     }
     printf("\n");
 }
 
-void addMatrices(int size, Matrix matrixA, Matrix matrixB, Matrix matrixC){
-    for (int row = 0; row < size; row++){
-        for (int col = 0; col < size; col++){
-            matrixC[row][col] = matrixA[row][col] + matrixB[row][col];
+void addMatrices(Matrix matrixA, Matrix matrixB, Matrix matrixC){
+    for (int row = 0; row < matrixC.rows; row++){
+        const int* a = matrixRow(matrixA, row);
+        const int* b = matrixRow(matrixB, row);
+        int* c = matrixRow(matrixC, row);
+        for (int col = 0; col < matrixC.cols; col++){
+            c[col] = a[col] + b[col];
         }
     }
 }
 
-void subtractMatrices(int size, Matrix matrixA, Matrix matrixB, Matrix matrixC){
-    for (int row = 0; row < size; row++){
-        for (int col = 0; col < size; col++){
-            matrixC[row][col] = matrixA[row][col] - matrixB[row][col];
+void subtractMatrices(Matrix matrixA, Matrix matrixB, Matrix matrixC){
+    for (int row = 0; row < matrixC.rows; row++){
+        const int* a = matrixRow(matrixA, row);
+        const int* b = matrixRow(matrixB, row);
+        int* c = matrixRow(matrixC, row);
+        for (int col = 0; col < matrixC.cols; col++){
+            c[col] = a[col] - b[col];
         }
     }
 }
 
-void randomizeMatrix(int size, Matrix matrix){
-    for (int row = 0; row < size; row++){
-        for(int col = 0; col < size; col++){
-            matrix[row][col] = rand() % 1000;
+void randomizeMatrix(Matrix matrix){
+    for (int row = 0; row < matrix.rows; row++){
+        int* m = matrixRow(matrix, row);
+        for(int col = 0; col < matrix.cols; col++){
+            m[col] = rand() % 1000;
         }
     }
 }
 
-Matrix allocateMatrix(int size){
-    Matrix matrix = (Matrix)malloc(size * sizeof(int*));
-    for (int i = 0; i < size; i++){
-        matrix[i] = (int*)malloc(size * sizeof(int));
+// One aligned block per matrix; the stride is rounded up so that every row
+// is aligned too
+Matrix allocateMatrix(int rows, int cols){
+    const int align = MATRIX_ALIGNMENT / sizeof(int);
+    Matrix matrix;
+    matrix.rows = rows;
+    matrix.cols = cols;
+    matrix.stride = (cols + align - 1) / align * align;
+    size_t bytes = (size_t)rows * matrix.stride * sizeof(int);
+    matrix.data = (int*)aligned_alloc(MATRIX_ALIGNMENT, bytes > 0 ? bytes : MATRIX_ALIGNMENT);
+    if (matrix.data == NULL){
+        printf("Unable to allocate %d * %d matrix\n", rows, cols);
+        exit(1);
     }
     return matrix;
 }
 
-void freeMatrix(Matrix matrix, int size){
-    for (int i = 0; i < size; i++){
-        free(matrix[i]);
-    }
-    free(matrix);
+void freeMatrix(Matrix matrix){
+    free(matrix.data);
 }
 
-void standardMultiply(int size, Matrix matrixA, Matrix matrixB, Matrix matrixC){
-    for (int row = 0; row < size; row++){
-        for (int col = 0; col < size; col++){
-            matrixC[row][col] = 0;
-            for (int k = 0; k < size; k++){
-                matrixC[row][col] += matrixA[row][k] * matrixB[k][col];
+// rows x cols submatrix of matrix at (rowOffset, colOffset); nothing is copied
+Matrix subMatrix(Matrix matrix, int rowOffset, int colOffset, int rows, int cols){
+    Matrix view;
+    view.data = matrixRow(matrix, rowOffset) + colOffset;
+    view.rows = rows;
+    view.cols = cols;
+    view.stride = matrix.stride;
+    return view;
+}
+
+void standardMultiply(Matrix matrixA, Matrix matrixB, Matrix matrixC){
+    for (int row = 0; row < matrixC.rows; row++){
+        const int* a = matrixRow(matrixA, row);
+        int* c = matrixRow(matrixC, row);
+        for (int col = 0; col < matrixC.cols; col++){
+            c[col] = 0;
+        }
+        // row-k-col order, so the inner loop runs along rows of B and C
+        for (int k = 0; k < matrixA.cols; k++){
+            const int aik = a[k];
+            const int* b = matrixRow(matrixB, k);
+            for (int col = 0; col < matrixC.cols; col++){
+                c[col] += aik * b[col];
             }
         }
     }
 }
 
-void copySubmatrix(int halfSize, int fullSize, int rowOffset, int colOffset, Matrix source, Matrix destination){
-    for (int row = 0; row < halfSize; row++){
-        for (int col = 0; col < halfSize; col++){
-            if (row + rowOffset < fullSize && col + colOffset < fullSize){
-                destination[row][col] = source[row + rowOffset][col + colOffset];
+// Copy source into the top left corner of destination, 0 everywhere else
+void copyMatrix(Matrix source, Matrix destination){
+    for (int row = 0; row < destination.rows; row++){
+        int* d = matrixRow(destination, row);
+        int col = 0;
+        if (row < source.rows){
+            const int* s = matrixRow(source, row);
+            for (; col < source.cols; col++){
+                d[col] = s[col];
             }
         }
+        for (; col < destination.cols; col++){
+            d[col] = 0;
+        }
     }
 }
 
-void strassenMultiply(int threshold, int size, Matrix matrixA, Matrix matrixB, Matrix matrixC){
+// Default number of recursion levels whose products are deferred tasks;
+// 7^2 = 49 tasks keep 8 ... 48 threads busy
+#ifndef STRASSEN_TASK_DEPTH
+#define STRASSEN_TASK_DEPTH 2
+#endif
+
+// Levels 0 ... taskDepth-1 create deferred tasks. Their last level creates
+// final tasks, so every task construct below is executed immediately by
+// the thread that reaches it, without being queued.
+void strassenMultiply(int threshold, int taskDepth, int depth, Matrix matrixA, Matrix matrixB, Matrix matrixC){
+    int size = matrixC.rows;
     if (size <= threshold){
-        standardMultiply(size, matrixA, matrixB, matrixC);
+        standardMultiply(matrixA, matrixB, matrixC);
+        return;
+    }
+
+    if (size % 2 == 1){
+        // Pad odd sizes once, so that all quadrants below are views
+        Matrix paddedA = allocateMatrix(size + 1, size + 1);
+        Matrix paddedB = allocateMatrix(size + 1, size + 1);
+        Matrix paddedC = allocateMatrix(size + 1, size + 1);
+        copyMatrix(matrixA, paddedA);
+        copyMatrix(matrixB, paddedB);
+        strassenMultiply(threshold, taskDepth, depth, paddedA, paddedB, paddedC);
+        copyMatrix(subMatrix(paddedC, 0, 0, size, size), matrixC);
+        freeMatrix(paddedA);
+        freeMatrix(paddedB);
+        freeMatrix(paddedC);
         return;
     }
-    int halfSize = (size + 1) / 2;
-
-    Matrix temp1 = allocateMatrix(halfSize);
-    Matrix temp2 = allocateMatrix(halfSize);
-    Matrix temp3 = allocateMatrix(halfSize);
-    Matrix temp4 = allocateMatrix(halfSize);
-    Matrix temp5 = allocateMatrix(halfSize);
-    Matrix temp6 = allocateMatrix(halfSize);
-    Matrix temp7 = allocateMatrix(halfSize);
-    Matrix temp8 = allocateMatrix(halfSize);
-    Matrix temp9 = allocateMatrix(halfSize);
-    Matrix temp10 = allocateMatrix(halfSize);
-
-    Matrix m1 = allocateMatrix(halfSize);
-    Matrix m2 = allocateMatrix(halfSize);
-    Matrix m3 = allocateMatrix(halfSize);
-    Matrix m4 = allocateMatrix(halfSize);
-    Matrix m5 = allocateMatrix(halfSize);
-    Matrix m6 = allocateMatrix(halfSize);
-    Matrix m7 = allocateMatrix(halfSize);
-
-    Matrix a11 = allocateMatrix(halfSize);
-    Matrix a12 = allocateMatrix(halfSize);
-    Matrix a21 = allocateMatrix(halfSize);
-    Matrix a22 = allocateMatrix(halfSize);
-
-    Matrix b11 = allocateMatrix(halfSize);
-    Matrix b12 = allocateMatrix(halfSize);
-    Matrix b21 = allocateMatrix(halfSize);
-    Matrix b22 = allocateMatrix(halfSize);
-
-    copySubmatrix(halfSize, size, 0, 0, matrixA, a11);
-    copySubmatrix(halfSize, size, 0, halfSize, matrixA, a12);
-    copySubmatrix(halfSize, size, halfSize, 0, matrixA, a21);
-    copySubmatrix(halfSize, size, halfSize, halfSize, matrixA, a22);
-
-    copySubmatrix(halfSize, size, 0, 0, matrixB, b11);
-    copySubmatrix(halfSize, size, 0, halfSize, matrixB, b12);
-    copySubmatrix(halfSize, size, halfSize, 0, matrixB, b21);
-    copySubmatrix(halfSize, size, halfSize, halfSize, matrixB, b22);
-
-    #pragma omp task
+
+    int halfSize = size / 2;
+
+    Matrix temp1 = allocateMatrix(halfSize, halfSize);
+    Matrix temp2 = allocateMatrix(halfSize, halfSize);
+    Matrix temp3 = allocateMatrix(halfSize, halfSize);
+    Matrix temp4 = allocateMatrix(halfSize, halfSize);
+    Matrix temp5 = allocateMatrix(halfSize, halfSize);
+    Matrix temp6 = allocateMatrix(halfSize, halfSize);
+    Matrix temp7 = allocateMatrix(halfSize, halfSize);
+    Matrix temp8 = allocateMatrix(halfSize, halfSize);
+    Matrix temp9 = allocateMatrix(halfSize, halfSize);
+    Matrix temp10 = allocateMatrix(halfSize, halfSize);
+
+    Matrix m1 = allocateMatrix(halfSize, halfSize);
+    Matrix m2 = allocateMatrix(halfSize, halfSize);
+    Matrix m3 = allocateMatrix(halfSize, halfSize);
+    Matrix m4 = allocateMatrix(halfSize, halfSize);
+    Matrix m5 = allocateMatrix(halfSize, halfSize);
+    Matrix m6 = allocateMatrix(halfSize, halfSize);
+    Matrix m7 = allocateMatrix(halfSize, halfSize);
+
+    Matrix a11 = subMatrix(matrixA, 0, 0, halfSize, halfSize);
+    Matrix a12 = subMatrix(matrixA, 0, halfSize, halfSize, halfSize);
+    Matrix a21 = subMatrix(matrixA, halfSize, 0, halfSize, halfSize);
+    Matrix a22 = subMatrix(matrixA, halfSize, halfSize, halfSize, halfSize);
+
+    Matrix b11 = subMatrix(matrixB, 0, 0, halfSize, halfSize);
+    Matrix b12 = subMatrix(matrixB, 0, halfSize, halfSize, halfSize);
+    Matrix b21 = subMatrix(matrixB, halfSize, 0, halfSize, halfSize);
+    Matrix b22 = subMatrix(matrixB, halfSize, halfSize, halfSize, halfSize);
+
+    // Only the seven largest subtrees get a priority (used when
+    // OMP_MAX_TASK_PRIORITY > 0): libgomp (GCC 12) crashes in taskwait when
+    // nested tasks use different nonzero priorities
+    int last = depth + 1 >= taskDepth;
+    int priority = (depth == 0) ? 1 : 0;
+
+    #pragma omp task final(last) mergeable priority(priority)
     {
-        addMatrices(halfSize, a11, a22, temp1);
-        addMatrices(halfSize, b11, b22, temp2);
-        strassenMultiply(threshold, halfSize, temp1, temp2, m1);
+        addMatrices(a11, a22, temp1);
+        addMatrices(b11, b22, temp2);
+        strassenMultiply(threshold, taskDepth, depth + 1, temp1, temp2, m1);
     }
 
-    #pragma omp task
+    #pragma omp task final(last) mergeable priority(priority)
     {
-        addMatrices(halfSize, a21, a22, temp3);
-        strassenMultiply(threshold, halfSize, temp3, b11, m2);
+        addMatrices(a21, a22, temp3);
+        strassenMultiply(threshold, taskDepth, depth + 1, temp3, b11, m2);
     }
 
-    #pragma omp task
+    #pragma omp task final(last) mergeable priority(priority)
     {
-        subtractMatrices(halfSize, b12, b22, temp4);
-        strassenMultiply(threshold, halfSize, a11, temp4, m3);
+        subtractMatrices(b12, b22, temp4);
+        strassenMultiply(threshold, taskDepth, depth + 1, a11, temp4, m3);
     }
 
-    #pragma omp task
+    #pragma omp task final(last) mergeable priority(priority)
     {
-        subtractMatrices(halfSize, b21, b11, temp5);
-        strassenMultiply(threshold, halfSize, a22, temp5, m4);
+        subtractMatrices(b21, b11, temp5);
+        strassenMultiply(threshold, taskDepth, depth + 1, a22, temp5, m4);
     }
 
-    #pragma omp task
+    #pragma omp task final(last) mergeable priority(priority)
     {
-        addMatrices(halfSize, a11, a12, temp6);
-        strassenMultiply(threshold, halfSize, temp6, b22, m5);
+        addMatrices(a11, a12, temp6);
+        strassenMultiply(threshold, taskDepth, depth + 1, temp6, b22, m5);
     }
 
-    #pragma omp task
+    #pragma omp task final(last) mergeable priority(priority)
     {
-        subtractMatrices(halfSize, a21, a11, temp7);
-        addMatrices(halfSize, b11, b12, temp8);
-        strassenMultiply(threshold, halfSize, temp7, temp8, m6);
+        subtractMatrices(a21, a11, temp7);
+        addMatrices(b11, b12, temp8);
+        strassenMultiply(threshold, taskDepth, depth + 1, temp7, temp8, m6);
     }
 
-    #pragma omp task
+    #pragma omp task final(last) mergeable priority(priority)
     {
-        subtractMatrices(halfSize, a12, a22, temp9);
-        addMatrices(halfSize, b21, b22, temp10);
-        strassenMultiply(threshold, halfSize, temp9, temp10, m7);
+        subtractMatrices(a12, a22, temp9);
+        addMatrices(b21, b22, temp10);
+        strassenMultiply(threshold, taskDepth, depth + 1, temp9, temp10, m7);
     }
 
     #pragma omp taskwait
 
     for (int row = 0; row < halfSize; row++){
+        const int* p1 = matrixRow(m1, row);
+        const int* p2 = matrixRow(m2, row);
+        const int* p3 = matrixRow(m3, row);
+        const int* p4 = matrixRow(m4, row);
+        const int* p5 = matrixRow(m5, row);
+        const int* p6 = matrixRow(m6, row);
+        const int* p7 = matrixRow(m7, row);
+        int* c11 = matrixRow(matrixC, row);
+        int* c12 = c11 + halfSize;
+        int* c21 = matrixRow(matrixC, row + halfSize);
+        int* c22 = c21 + halfSize;
         for(int col = 0; col < halfSize; col++){
-            matrixC[row][col] = m1[row][col] + m4[row][col] - m5[row][col] + m7[row][col];
-            if (col + halfSize < size){
-                matrixC[row][col + halfSize] = m3[row][col] + m5[row][col];
-            }
-            if (row + halfSize < size){
-                matrixC[row + halfSize][col] = m2[row][col] + m4[row][col];
-            }
-            if (row + halfSize < size && col + halfSize < size){
-                matrixC[row + halfSize][col + halfSize] = m1[row][col] - m2[row][col] + m3[row][col] + m6[row][col];
+            c11[col] = p1[col] + p4[col] - p5[col] + p7[col];
+            c12[col] = p3[col] + p5[col];
+            c21[col] = p2[col] + p4[col];
+            c22[col] = p1[col] - p2[col] + p3[col] + p6[col];
+        }
+    }
+
+    freeMatrix(temp1);
+    freeMatrix(temp2);
+    freeMatrix(temp3);
+    freeMatrix(temp4);
+    freeMatrix(temp5);
+    freeMatrix(temp6);
+    freeMatrix(temp7);
+    freeMatrix(temp8);
+    freeMatrix(temp9);
+    freeMatrix(temp10);
+
+    freeMatrix(m1);
+    freeMatrix(m2);
+    freeMatrix(m3);
+    freeMatrix(m4);
+    freeMatrix(m5);
+    freeMatrix(m6);
+    freeMatrix(m7);
+}
+
+// Crossover threshold and thread count for this machine, found by
+// autotuneStrassen and kept in a tuning file of "key value" lines, which
+// later runs load at startup
+#define TUNING_FILE "strassen_tuning_final.txt"
+#define DEFAULT_THRESHOLD 64
+
+// Sizes benchmarked for the crossover, and the product timed for the thread
+// count
+#define TUNE_MIN_SIZE 32
+#define TUNE_MAX_SIZE 1024
+#define TUNE_SIZE 1024
+
+typedef struct Tuning{
+    int threshold;
+    int threads;
+} Tuning;
+
+// Entries missing from the file keep their value; returns 0 if the file
+// cannot be read
+int loadTuning(const char* path, Tuning* tuning){
+    FILE* file = fopen(path, "r");
+    if (file == NULL) return 0;
+    char key[64];
+    int value;
+    while (fscanf(file, "%63s %d", key, &value) == 2){
+        if (strcmp(key, "threshold") == 0 && value > 0) tuning->threshold = value;
+        if (strcmp(key, "threads") == 0 && value > 0) tuning->threads = value;
+    }
+    fclose(file);
+    return 1;
+}
+
+int saveTuning(const char* path, const Tuning* tuning){
+    FILE* file = fopen(path, "w");
+    if (file == NULL) return 0;
+    fprintf(file, "threshold %d\n", tuning->threshold);
+    fprintf(file, "threads %d\n", tuning->threads);
+    fclose(file);
+    return 1;
+}
+
+// Shortest of at least 3 runs (and at least 0.1 s of runs) of
+// strassenMultiply with the given number of threads
+double timeStrassen(int threshold, int taskDepth, int threads, Matrix matrixA, Matrix matrixB, Matrix matrixC){
+    double best = 0, total = 0;
+    for (int run = 0; run < 3 || total < 0.1; run++){
+        double time = omp_get_wtime();
+        #pragma omp parallel num_threads(threads)
+        {
+            #pragma omp single
+            {
+                strassenMultiply(threshold, taskDepth, 0, matrixA, matrixB, matrixC);
             }
         }
+        time = omp_get_wtime() - time;
+        if (run == 0 || time < best) best = time;
+        total += time;
+    }
+    return best;
+}
+
+// The threshold is the largest size below the first one at which one
+// Strassen level beats standardMultiply on one thread; the thread count is
+// the fastest of 1, 2, 4, ... up to the number of processors for a
+// TUNE_SIZE product with that threshold
+Tuning autotuneStrassen(){
+    Tuning tuning;
+    tuning.threshold = TUNE_MAX_SIZE;
+    printf("%8s %14s %12s\n", "size", "standard (sec)", "level (sec)");
+    for (int size = TUNE_MIN_SIZE; size <= TUNE_MAX_SIZE; size *= 2){
+        Matrix matrixA = allocateMatrix(size, size);
+        Matrix matrixB = allocateMatrix(size, size);
+        Matrix matrixC = allocateMatrix(size, size);
+        randomizeMatrix(matrixA);
+        randomizeMatrix(matrixB);
+        double level = timeStrassen(size / 2, 0, 1, matrixA, matrixB, matrixC);
+        double standard = timeStrassen(size, 0, 1, matrixA, matrixB, matrixC);
+        printf("%8d %14.6f %12.6f\n", size, standard, level);
+        freeMatrix(matrixA);
+        freeMatrix(matrixB);
+        freeMatrix(matrixC);
+        if (level < standard){
+            tuning.threshold = size / 2;
+            break;
+        }
     }
 
-    freeMatrix(temp1, halfSize);
-    freeMatrix(temp2, halfSize);
-    freeMatrix(temp3, halfSize);
-    freeMatrix(temp4, halfSize);
-    freeMatrix(temp5, halfSize);
-    freeMatrix(temp6, halfSize);
-    freeMatrix(temp7, halfSize);
-    freeMatrix(temp8, halfSize);
-    freeMatrix(temp9, halfSize);
-    freeMatrix(temp10, halfSize);
-
-    freeMatrix(m1, halfSize);
-    freeMatrix(m2, halfSize);
-    freeMatrix(m3, halfSize);
-    freeMatrix(m4, halfSize);
-    freeMatrix(m5, halfSize);
-    freeMatrix(m6, halfSize);
-    freeMatrix(m7, halfSize);
-
-    freeMatrix(a11, halfSize);
-    freeMatrix(a12, halfSize);
-    freeMatrix(a21, halfSize);
-    freeMatrix(a22, halfSize);
-
-    freeMatrix(b11, halfSize);
-    freeMatrix(b12, halfSize);
-    freeMatrix(b21, halfSize);
-    freeMatrix(b22, halfSize);
+    Matrix matrixA = allocateMatrix(TUNE_SIZE, TUNE_SIZE);
+    Matrix matrixB = allocateMatrix(TUNE_SIZE, TUNE_SIZE);
+    Matrix matrixC = allocateMatrix(TUNE_SIZE, TUNE_SIZE);
+    randomizeMatrix(matrixA);
+    randomizeMatrix(matrixB);
+    int procs = omp_get_num_procs();
+    double best = 0;
+    printf("%8s %14s\n", "threads", "time (sec)");
+    for (int threads = 1; ; threads *= 2){
+        if (threads > procs) threads = procs;
+        double time = timeStrassen(tuning.threshold, STRASSEN_TASK_DEPTH, threads, matrixA, matrixB, matrixC);
+        printf("%8d %14.6f\n", threads, time);
+        if (threads == 1 || time < best){
+            best = time;
+            tuning.threads = threads;
+        }
+        if (threads == procs) break;
+    }
+    freeMatrix(matrixA);
+    freeMatrix(matrixB);
+    freeMatrix(matrixC);
+    return tuning;
 }
 
-int compareMatrices(int size, Matrix matrixA, Matrix matrixB){
-    for (int row = 0; row < size; row++){
-        for (int col = 0; col < size; col++){
-            if(matrixA[row][col] != matrixB[row][col]) return 0;
+int compareMatrices(Matrix matrixA, Matrix matrixB){
+    for (int row = 0; row < matrixA.rows; row++){
+        const int* a = matrixRow(matrixA, row);
+        const int* b = matrixRow(matrixB, row);
+        for (int col = 0; col < matrixA.cols; col++){
+            if(a[col] != b[col]) return 0;
         }
     }
     return 1;
@@ -226,51 +411,89 @@ int main(int argc, char* argv[]){
     struct timespec start, stop, startStandard, stopStandard;
     double strassenTime, standardTime;
 
-    if (argc != 3) {
-        printf("Need two integers as input \n");
+    int autotune = 0;
+    int threads = 0;
+    const char* tuningFile = TUNING_FILE;
+    int option;
+
+    while ((option = getopt(argc, argv, "af:p:")) != -1){
+        switch (option){
+            case 'a':
+                autotune = 1;
+                break;
+            case 'f':
+                tuningFile = optarg;
+                break;
+            case 'p':
+                threads = atoi(optarg);
+                break;
+            default:
+                exit(0);
+        }
+    }
+    if (argc - optind < 1 || argc - optind > 3) {
+        printf("Need one to three integers as input \n");
+        printf("Use: <executable_name> [-a] [-f tuning_file] [-p threads] <log_2(matrix_size)> [log_2(threshold) [task_depth]]\n");
+        printf("Without log_2(threshold), the threshold and number of threads are loaded from the tuning file; -a writes it\n");
         exit(0);
     }
 
-    int size = (1 << atoi(argv[1]));
-    int threshold = (1 << atoi(argv[2]));
+    Tuning tuning;
+    tuning.threshold = DEFAULT_THRESHOLD;
+    tuning.threads = omp_get_max_threads();
+    if (autotune){
+        tuning = autotuneStrassen();
+        if (!saveTuning(tuningFile, &tuning)){
+            printf("Unable to write tuning file %s\n", tuningFile);
+        }
+        printf("Tuned threshold = %d, threads = %d\n", tuning.threshold, tuning.threads);
+    }
+    else{
+        loadTuning(tuningFile, &tuning);
+    }
+
+    int size = (1 << atoi(argv[optind]));
+    int threshold = (argc - optind >= 2) ? (1 << atoi(argv[optind + 1])) : tuning.threshold;
+    int taskDepth = (argc - optind == 3) ? atoi(argv[optind + 2]) : STRASSEN_TASK_DEPTH;
+    if (threads <= 0) threads = tuning.threads;
 
-    Matrix matrixA = allocateMatrix(size);
-    Matrix matrixB = allocateMatrix(size);
-    Matrix matrixC = allocateMatrix(size);
-    Matrix matrixCseq = allocateMatrix(size);
+    Matrix matrixA = allocateMatrix(size, size);
+    Matrix matrixB = allocateMatrix(size, size);
+    Matrix matrixC = allocateMatrix(size, size);
+    Matrix matrixCseq = allocateMatrix(size, size);
 
-    randomizeMatrix(size, matrixA);
-    randomizeMatrix(size, matrixB);
+    randomizeMatrix(matrixA);
+    randomizeMatrix(matrixB);
 
     clock_gettime(CLOCK_REALTIME, &start);
-    omp_set_num_threads(8);
+    omp_set_num_threads(threads);
     #pragma omp parallel
     {
         #pragma omp single
         {
-            strassenMultiply(threshold, size, matrixA, matrixB, matrixC);
+            strassenMultiply(threshold, taskDepth, 0, matrixA, matrixB, matrixC);
         }
     }
     clock_gettime(CLOCK_REALTIME, &stop);
     strassenTime = (stop.tv_sec - start.tv_sec) + 0.000000001 * (stop.tv_nsec - start.tv_nsec);
 
     clock_gettime(CLOCK_REALTIME, &startStandard);
-    standardMultiply(size, matrixA, matrixB, matrixCseq);
+    standardMultiply(matrixA, matrixB, matrixCseq);
     clock_gettime(CLOCK_REALTIME, &stopStandard);
     standardTime = (stopStandard.tv_sec - startStandard.tv_sec) + 0.000000001 * (stopStandard.tv_nsec - startStandard.tv_nsec);
 
-    if (compareMatrices(size, matrixC, matrixCseq)){
-        printf("Matrix Size = %d * %d, Threshold = %d, error = %d, time (Strassen) = %8.4f, standard_time = %8.4f\n", 
-            size, size, threshold, 0, strassenTime, standardTime);
+    if (compareMatrices(matrixC, matrixCseq)){
+        printf("Matrix Size = %d * %d, Threshold = %d, Threads = %d, error = %d, time (Strassen) = %8.4f, standard_time = %8.4f\n",
+            size, size, threshold, threads, 0, strassenTime, standardTime);
     }
     else{
         printf("Houston, We have a problem!\n");
     }
 
-    freeMatrix(matrixA, size);
-    freeMatrix(matrixB, size);
-    freeMatrix(matrixC, size);
-    freeMatrix(matrixCseq, size);
+    freeMatrix(matrixA);
+    freeMatrix(matrixB);
+    freeMatrix(matrixC);
+    freeMatrix(matrixCseq);
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <time.h>
+#include <omp.h>
+
+using namespace std;
+
+// CPU stand-in for major_project.cu. The kernels work on the same flat,
+// row-major int buffers, but are written as OpenMP target regions instead
+// of CUDA kernels: "target teams distribute" splits the rows (or tiles) of
+// the result among teams, as the CUDA grid splits them among blocks, and
+// "parallel for" among the threads of a team. The regions run on
+// MATRIX_DEVICE, which is the host unless overridden, so the module builds
+// and runs on machines without a GPU:
+//
+//     g++ -O3 -march=native -fopenmp -o major_project_cpu.exe major_project_cpu.cpp
+//
+// On the host the map clauses do nothing. With -DMATRIX_DEVICE=0 and an
+// offloading compiler, every kernel call copies its operands to the device
+// and back.
+#ifndef MATRIX_DEVICE
+#define MATRIX_DEVICE omp_get_initial_device()
+#endif
+
+// Kernels on blocks smaller than KERNEL_PARALLEL_MIN x KERNEL_PARALLEL_MIN
+// run on one thread, since starting the threads would cost more than the
+// work; the lower levels of Strassen call many such kernels
+#define KERNEL_PARALLEL_MIN 128
+
+// Side of the square tiles of C computed by one iteration of the multiply
+// kernel, and of the blocks of A and B it steps through
+#define MUL_TILE 64
+
+// A block of a flat matrix is addressed by its first element and the row
+// length (leading dimension) of the full matrix: element (row, col) of the
+// n x n block at A with leading dimension lda is A[row * lda + col], and
+// the block spans MATRIX_SPAN(n, lda) elements from A.
+#define MATRIX_SPAN(n, ld) ((size_t)((n) - 1) * (ld) + (n))
+
+// Kernel for matrix addition
+void matrixAddKernel(int n, const int* A, int lda, const int* B, int ldb, int* C, int ldc) {
+    #pragma omp target teams distribute parallel for device(MATRIX_DEVICE) if(parallel: n >= KERNEL_PARALLEL_MIN) \
+        map(to: A[0:MATRIX_SPAN(n, lda)], B[0:MATRIX_SPAN(n, ldb)]) map(from: C[0:MATRIX_SPAN(n, ldc)])
+    for (int row = 0; row < n; row++) {
+        #pragma omp simd
+        for (int col = 0; col < n; col++) {
+            C[row * ldc + col] = A[row * lda + col] + B[row * ldb + col];
+        }
+    }
+}
+
+// Kernel for matrix subtraction
+void matrixSubKernel(int n, const int* A, int lda, const int* B, int ldb, int* C, int ldc) {
+    #pragma omp target teams distribute parallel for device(MATRIX_DEVICE) if(parallel: n >= KERNEL_PARALLEL_MIN) \
+        map(to: A[0:MATRIX_SPAN(n, lda)], B[0:MATRIX_SPAN(n, ldb)]) map(from: C[0:MATRIX_SPAN(n, ldc)])
+    for (int row = 0; row < n; row++) {
+        #pragma omp simd
+        for (int col = 0; col < n; col++) {
+            C[row * ldc + col] = A[row * lda + col] - B[row * ldb + col];
+        }
+    }
+}
+
+// Kernel for standard matrix multiplication, tiled: each iteration computes
+// one MUL_TILE x MUL_TILE tile of C from a row of tiles of A and a column of
+// tiles of B. Each tile of B is first copied into a contiguous local buffer,
+// as a CUDA block would load it into shared memory; this also keeps rows of
+// B that are a large power of two apart from evicting each other. Within a
+// tile the loops run row, k, col, so that the innermost loop is a
+// vectorizable update of a row of C.
+void matrixMulKernel(int n, const int* A, int lda, const int* B, int ldb, int* C, int ldc) {
+    int tiles = (n + MUL_TILE - 1) / MUL_TILE;
+
+    #pragma omp target teams distribute parallel for collapse(2) device(MATRIX_DEVICE) if(parallel: n >= KERNEL_PARALLEL_MIN) \
+        map(to: A[0:MATRIX_SPAN(n, lda)], B[0:MATRIX_SPAN(n, ldb)]) map(from: C[0:MATRIX_SPAN(n, ldc)])
+    for (int tileRow = 0; tileRow < tiles; tileRow++) {
+        for (int tileCol = 0; tileCol < tiles; tileCol++) {
+            int rowStart = tileRow * MUL_TILE;
+            int colStart = tileCol * MUL_TILE;
+            int rowEnd = (rowStart + MUL_TILE < n) ? rowStart + MUL_TILE : n;
+            int colEnd = (colStart + MUL_TILE < n) ? colStart + MUL_TILE : n;
+            int tileB[MUL_TILE * MUL_TILE];
+
+            for (int row = rowStart; row < rowEnd; row++) {
+                for (int col = colStart; col < colEnd; col++) {
+                    C[row * ldc + col] = 0;
+                }
+            }
+            for (int kStart = 0; kStart < n; kStart += MUL_TILE) {
+                int kEnd = (kStart + MUL_TILE < n) ? kStart + MUL_TILE : n;
+                for (int k = kStart; k < kEnd; k++) {
+                    for (int col = colStart; col < colEnd; col++) {
+                        tileB[(k - kStart) * MUL_TILE + col - colStart] = B[k * ldb + col];
+                    }
+                }
+                for (int row = rowStart; row < rowEnd; row++) {
+                    int* c = C + row * ldc + colStart;
+                    for (int k = kStart; k < kEnd; k++) {
+                        const int a = A[row * lda + k];
+                        const int* b = tileB + (k - kStart) * MUL_TILE;
+                        #pragma omp simd
+                        for (int col = 0; col < colEnd - colStart; col++) {
+                            c[col] += a * b[col];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Kernel combining the seven Strassen products (h x h, leading dimension h)
+// into the quadrants of C
+void matrixCombineKernel(int h, const int* M1, const int* M2, const int* M3, const int* M4,
+                         const int* M5, const int* M6, const int* M7, int* C, int ldc) {
+    size_t size = (size_t)h * h;
+
+    #pragma omp target teams distribute parallel for device(MATRIX_DEVICE) if(parallel: h >= KERNEL_PARALLEL_MIN) \
+        map(to: M1[0:size], M2[0:size], M3[0:size], M4[0:size], M5[0:size], M6[0:size], M7[0:size]) \
+        map(from: C[0:MATRIX_SPAN(2 * h, ldc)])
+    for (int row = 0; row < h; row++) {
+        int* c11 = C + row * ldc;
+        int* c12 = c11 + h;
+        int* c21 = C + (row + h) * ldc;
+        int* c22 = c21 + h;
+        #pragma omp simd
+        for (int col = 0; col < h; col++) {
+            int i = row * h + col;
+            c11[col] = M1[i] + M4[i] - M5[i] + M7[i];
+            c12[col] = M3[i] + M5[i];
+            c21[col] = M2[i] + M4[i];
+            c22[col] = M1[i] - M2[i] + M3[i] + M6[i];
+        }
+    }
+}
+
+// Strassen's algorithm on flat buffers: C = A * B for n x n blocks. The
+// recursion runs on the host, one level at a time, and every addition,
+// multiplication and combination is a kernel call, as it would be with the
+// CUDA kernels. Odd sizes fall back to the standard multiply.
+void matrixStrassen(int n, int threshold, const int* A, int lda, const int* B, int ldb, int* C, int ldc) {
+    if (n <= threshold || n % 2 == 1) {
+        matrixMulKernel(n, A, lda, B, ldb, C, ldc);
+        return;
+    }
+
+    int h = n / 2;
+    size_t size = (size_t)h * h;
+
+    const int* A11 = A;
+    const int* A12 = A + h;
+    const int* A21 = A + h * lda;
+    const int* A22 = A + h * lda + h;
+
+    const int* B11 = B;
+    const int* B12 = B + h;
+    const int* B21 = B + h * ldb;
+    const int* B22 = B + h * ldb + h;
+
+    // Two operand buffers and the seven products, all h x h with leading
+    // dimension h, in one allocation
+    int* buffer = (int*)malloc(9 * size * sizeof(int));
+    int* T1 = buffer;
+    int* T2 = buffer + size;
+    int* M1 = buffer + 2 * size;
+    int* M2 = buffer + 3 * size;
+    int* M3 = buffer + 4 * size;
+    int* M4 = buffer + 5 * size;
+    int* M5 = buffer + 6 * size;
+    int* M6 = buffer + 7 * size;
+    int* M7 = buffer + 8 * size;
+
+    // M1 = (A11 + A22) (B11 + B22)
+    matrixAddKernel(h, A11, lda, A22, lda, T1, h);
+    matrixAddKernel(h, B11, ldb, B22, ldb, T2, h);
+    matrixStrassen(h, threshold, T1, h, T2, h, M1, h);
+
+    // M2 = (A21 + A22) B11
+    matrixAddKernel(h, A21, lda, A22, lda, T1, h);
+    matrixStrassen(h, threshold, T1, h, B11, ldb, M2, h);
+
+    // M3 = A11 (B12 - B22)
+    matrixSubKernel(h, B12, ldb, B22, ldb, T2, h);
+    matrixStrassen(h, threshold, A11, lda, T2, h, M3, h);
+
+    // M4 = A22 (B21 - B11)
+    matrixSubKernel(h, B21, ldb, B11, ldb, T2, h);
+    matrixStrassen(h, threshold, A22, lda, T2, h, M4, h);
+
+    // M5 = (A11 + A12) B22
+    matrixAddKernel(h, A11, lda, A12, lda, T1, h);
+    matrixStrassen(h, threshold, T1, h, B22, ldb, M5, h);
+
+    // M6 = (A21 - A11) (B11 + B12)
+    matrixSubKernel(h, A21, lda, A11, lda, T1, h);
+    matrixAddKernel(h, B11, ldb, B12, ldb, T2, h);
+    matrixStrassen(h, threshold, T1, h, T2, h, M6, h);
+
+    // M7 = (A12 - A22) (B21 + B22)
+    matrixSubKernel(h, A12, lda, A22, lda, T1, h);
+    matrixAddKernel(h, B21, ldb, B22, ldb, T2, h);
+    matrixStrassen(h, threshold, T1, h, T2, h, M7, h);
+
+    matrixCombineKernel(h, M1, M2, M3, M4, M5, M6, M7, C, ldc);
+
+    free(buffer);
+}
+
+// Allocate and initialize matrix on host
+void matrixRand(int n, int*& matrix) {
+    matrix = (int*)malloc((size_t)n * n * sizeof(int));
+    for (size_t i = 0; i < (size_t)n * n; i++) {
+        matrix[i] = rand() % 1000;
+    }
+}
+
+// Print matrix
+void matrixPrint(int n, int* matrix) {
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            cout << matrix[i * n + j] << " ";
+        }
+        cout << endl;
+    }
+}
+
+bool matrixCompare(int n, int* A, int* B) {
+    for (size_t i = 0; i < (size_t)n * n; i++) {
+        if (A[i] != B[i]) return false;
+    }
+    return true;
+}
+
+// Main function
+int main(int argc, char* argv[]) {
+    struct timespec start, stop, start_standard, stop_standard;
+    double total_time, total_time_standard;
+
+    if (argc != 3) {
+        printf("Need two integers as input \n");
+        printf("Use: <executable_name> <log_2(matrix_size)> <log_2(threshold)>\n");
+        exit(0);
+    }
+
+    int n = (1 << atoi(argv[1]));
+    int threshold = (1 << atoi(argv[2]));
+
+    int* A;
+    int* B;
+    matrixRand(n, A);
+    matrixRand(n, B);
+    int* C = (int*)malloc((size_t)n * n * sizeof(int));
+    int* Cseq = (int*)malloc((size_t)n * n * sizeof(int));
+
+    // Strassen Multiplication with the kernels
+    clock_gettime(CLOCK_REALTIME, &start);
+    matrixStrassen(n, threshold, A, n, B, n, C, n);
+    clock_gettime(CLOCK_REALTIME, &stop);
+    total_time = (stop.tv_sec - start.tv_sec) + 0.000000001 * (stop.tv_nsec - start.tv_nsec);
+
+    // Standard Multiplication: one call of the multiply kernel
+    clock_gettime(CLOCK_REALTIME, &start_standard);
+    matrixMulKernel(n, A, n, B, n, Cseq, n);
+    clock_gettime(CLOCK_REALTIME, &stop_standard);
+    total_time_standard = (stop_standard.tv_sec - start_standard.tv_sec) + 0.000000001 * (stop_standard.tv_nsec - start_standard.tv_nsec);
+
+    // Check answer
+    if (matrixCompare(n, C, Cseq)) {
+        cout << "Correct!!!" << endl;
+        printf("Matrix Size = %d * %d, Threshold = %d, Threads = %d, time (sec) = %8.4f, standard_time = %8.4f\n",
+               n, n, threshold, omp_get_max_threads(), total_time, total_time_standard);
+    } else {
+        cout << "We have a problem!" << endl;
+    }
+
+    free(A);
+    free(B);
+    free(C);
+    free(Cseq);
+
+    return 0;
+}
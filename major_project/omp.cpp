@@ -1,284 +1,1310 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
 #include <time.h>
+#include <unistd.h>
 #include <omp.h>
+#include <limits>
+#include <type_traits>
 
-void matrixPrint(int n, int** matrix) {
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < n; j++) {
-            printf("%d ", matrix[i][j]);
+#include "../common/list_init.h"
+
+// Rows of every allocated matrix start on a MATRIX_ALIGNMENT byte boundary
+#define MATRIX_ALIGNMENT 64
+
+// Row-major matrix of elements of type T (int32_t, int64_t, float or
+// double), or a view of a submatrix of one: element (i, j) is
+// ptr[i * ld + j]. A view shares storage with its parent, so quadrants of
+// a matrix are taken without copying.
+template <typename T>
+struct Matrix {
+    T* ptr;
+    int rows;
+    int cols;
+    int ld;     // Leading dimension: distance between rows, in elements
+};
+
+template <typename T>
+static inline T* matrixRow(Matrix<T> M, int i) {
+    return M.ptr + (size_t)i * M.ld;
+}
+
+template <typename T>
+void matrixPrint(Matrix<T> M) {
+    for (int i = 0; i < M.rows; i++) {
+        const T* m = matrixRow(M, i);
+        for (int j = 0; j < M.cols; j++) {
+            if (std::numeric_limits<T>::is_integer) {
+                printf("%lld ", (long long)m[j]);
+            } else {
+                printf("%g ", (double)m[j]);
+            }
         }
         printf("\n");
     }
     printf("\n");
 }
 
-void matrixAdd(int n, int** A, int** B, int** C) {
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < n; j++) {
-            C[i][j] = A[i][j] + B[i][j];
+template <typename T>
+void matrixAdd(Matrix<T> A, Matrix<T> B, Matrix<T> C) {
+    for (int i = 0; i < C.rows; i++) {
+        const T* a = matrixRow(A, i);
+        const T* b = matrixRow(B, i);
+        T* c = matrixRow(C, i);
+        for (int j = 0; j < C.cols; j++) {
+            c[j] = a[j] + b[j];
         }
     }
 }
 
-void matrixSub(int n, int** A, int** B, int** C) {
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < n; j++) {
-            C[i][j] = A[i][j] - B[i][j];
+template <typename T>
+void matrixSub(Matrix<T> A, Matrix<T> B, Matrix<T> C) {
+    for (int i = 0; i < C.rows; i++) {
+        const T* a = matrixRow(A, i);
+        const T* b = matrixRow(B, i);
+        T* c = matrixRow(C, i);
+        for (int j = 0; j < C.cols; j++) {
+            c[j] = a[j] - b[j];
         }
     }
 }
 
-void matrixRand(int n, int** matrix) {
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < n; j++) {
-            matrix[i][j] = rand() % 1000;
+// Random value in [-1, 1) from the 64-bit random value r
+static inline double unitRandom(unsigned long long r) {
+    return (r >> 11) * (1.0 / 9007199254740992.0) * 2 - 1;
+}
+
+// Integer matrices get values in 0 ... 999, floating-point ones in [-1, 1).
+// Element (i, j) is a function of seed and i * cols + j only (counter-based,
+// see mix64), so rows are filled in parallel and the result does not
+// depend on the number of threads.
+#define MATRIX_SEED_A 1
+#define MATRIX_SEED_B 2
+
+template <typename T>
+void matrixRand(Matrix<T> M, unsigned long long seed) {
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < M.rows; i++) {
+        T* m = matrixRow(M, i);
+        unsigned long long first = seed * 0x2545f4914f6cdd1dULL + (unsigned long long)i * M.cols;
+        for (int j = 0; j < M.cols; j++) {
+            unsigned long long r = mix64(first + j);
+            if (std::numeric_limits<T>::is_integer) {
+                m[j] = r % 1000;
+            } else {
+                m[j] = unitRandom(r);
+            }
         }
     }
 }
 
-int** matrixAllocate(int n) {
-    int** matrix = (int**)malloc(n * sizeof(int*));
-    for (int i = 0; i < n; i++) {
-        matrix[i] = (int*)malloc(n * sizeof(int));
+// Leading dimension of a matrix with cols columns, rounded up so that every
+// row is aligned
+template <typename T>
+static inline int matrixLeadingDim(int cols) {
+    const int align = MATRIX_ALIGNMENT / sizeof(T);
+    return (cols + align - 1) / align * align;
+}
+
+// Number of elements of storage taken by a rows x cols matrix; always a
+// multiple of MATRIX_ALIGNMENT / sizeof(T)
+template <typename T>
+static inline size_t matrixElements(int rows, int cols) {
+    return (size_t)rows * matrixLeadingDim<T>(cols);
+}
+
+// Allocate n elements in one aligned block
+template <typename T>
+T* alignedAllocate(size_t n) {
+    size_t bytes = n * sizeof(T);
+    T* ptr = (T*)aligned_alloc(MATRIX_ALIGNMENT, bytes > 0 ? bytes : MATRIX_ALIGNMENT);
+    if (ptr == NULL) {
+        printf("Unable to allocate %zu bytes\n", bytes);
+        exit(1);
     }
-    return matrix;
+    return ptr;
+}
+
+// Allocate a rows x cols matrix in one aligned block
+template <typename T>
+Matrix<T> matrixAllocate(int rows, int cols) {
+    Matrix<T> M;
+    M.rows = rows;
+    M.cols = cols;
+    M.ld = matrixLeadingDim<T>(cols);
+    M.ptr = alignedAllocate<T>(matrixElements<T>(rows, cols));
+    return M;
+}
+
+template <typename T>
+void matrixFree(Matrix<T> M) {
+    free(M.ptr);
+}
+
+// Take a rows x cols matrix from the front of workspace *work and advance
+// *work past it
+template <typename T>
+Matrix<T> matrixTake(T** work, int rows, int cols) {
+    Matrix<T> M;
+    M.rows = rows;
+    M.cols = cols;
+    M.ld = matrixLeadingDim<T>(cols);
+    M.ptr = *work;
+    *work += matrixElements<T>(rows, cols);
+    return M;
 }
 
-void matrixFree(int** matrix, int n) {
-    for (int i = 0; i < n; ++i) {
-        free(matrix[i]);
+// rows x cols submatrix of M starting at element (i, j); no data is copied
+template <typename T>
+Matrix<T> matrixView(Matrix<T> M, int i, int j, int rows, int cols) {
+    Matrix<T> V;
+    V.ptr = matrixRow(M, i) + j;
+    V.rows = rows;
+    V.cols = cols;
+    V.ld = M.ld;
+    return V;
+}
+
+// Sum of up to MATRIX_SUM_TERMS equally sized matrices, each added (sign +1)
+// or subtracted (sign -1). Strassen operands such as A11 - A21 are passed
+// around in this form and only evaluated when needed, so that the base case
+// can form them while packing instead of in a separate pass.
+#define MATRIX_SUM_TERMS 4
+
+template <typename T>
+struct MatrixSum {
+    int terms;
+    Matrix<T> term[MATRIX_SUM_TERMS];
+    int sign[MATRIX_SUM_TERMS];
+};
+
+// C = S, in a single pass over the terms
+template <typename T>
+void matrixEvaluate(const MatrixSum<T>* S, Matrix<T> C) {
+    for (int i = 0; i < C.rows; i++) {
+        T* c = matrixRow(C, i);
+        const T* x = matrixRow(S->term[0], i);
+        const int s = S->sign[0];
+        for (int j = 0; j < C.cols; j++) {
+            c[j] = s * x[j];
+        }
+        for (int t = 1; t < S->terms; t++) {
+            const T* y = matrixRow(S->term[t], i);
+            if (S->sign[t] > 0) {
+                for (int j = 0; j < C.cols; j++) {
+                    c[j] += y[j];
+                }
+            } else {
+                for (int j = 0; j < C.cols; j++) {
+                    c[j] -= y[j];
+                }
+            }
+        }
     }
-    free(matrix);
 }
 
-void matrixStandardMul(int n, int** A, int** B, int** C) {
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < n; j++) {
-            C[i][j] = 0;
-            for (int k = 0; k < n; k++) {
-                C[i][j] += A[i][k] * B[k][j];
+// Packed, cache-blocked GEMM used for the Strassen base case and for the
+// standard multiply. C is computed in NC x KC x MC blocks: a KC x NC panel of
+// B is packed into GEMM_NR wide micro-panels (kept in L3/L2), an MC x KC block
+// of A into GEMM_MR tall micro-panels (kept in L2), and the micro-kernel
+// computes one GEMM_MR x GEMM_NR tile of C in registers from a micro-panel
+// of each (kept in L1).
+//
+// The micro-kernel is written with GCC vector extensions, so one kernel
+// serves every element type. Build with -mavx2 or -mavx512f (or
+// -march=native) for 32 or 64 byte vectors; otherwise 16 byte vectors are
+// used, which the compiler maps to SSE or splits into scalar code.
+#define GEMM_MC 72
+#define GEMM_KC 256
+#define GEMM_NC 2048
+#define GEMM_MR 6
+
+#if defined(__AVX512F__)
+#define GEMM_VEC_BYTES 64
+#elif defined(__AVX2__)
+#define GEMM_VEC_BYTES 32
+#else
+#define GEMM_VEC_BYTES 16
+#endif
+
+// Each row of a micro-tile is two vectors of T wide
+#define GEMM_NR(T) (2 * GEMM_VEC_BYTES / (int)sizeof(T))
+
+static inline int roundUp(int x, int m) {
+    return (x + m - 1) / m * m;
+}
+
+// Number of workspace elements matrixGemm needs for an m x k times k x n
+// product: one packed block of A, one packed panel of B and one block of
+// scratch for evaluating operand sums of A
+template <typename T>
+size_t gemmWorkspace(int m, int n, int k) {
+    int mc = m < GEMM_MC ? m : GEMM_MC;
+    int nc = n < GEMM_NC ? n : GEMM_NC;
+    int kc = k < GEMM_KC ? k : GEMM_KC;
+    return matrixElements<T>(roundUp(mc, GEMM_MR), kc) + matrixElements<T>(kc, roundUp(nc, GEMM_NR(T))) +
+           matrixElements<T>(mc, kc);
+}
+
+// Pack the mc x kc block at (i, p) of the operand sum A into micro-panels of
+// GEMM_MR rows, stored column by column; rows past mc are filled with 0.
+// A sum of several terms is first evaluated, block by block, into scratch
+// (which stays in L2), so that the column-wise gather reads one matrix.
+template <typename T>
+static void gemmPackA(const MatrixSum<T>* A, int i, int p, int mc, int kc, T* packed, T* scratch) {
+    Matrix<T> S = A->term[0];
+    int sign = A->sign[0];
+    if (A->terms > 1) {
+        MatrixSum<T> block;
+        block.terms = A->terms;
+        for (int t = 0; t < A->terms; t++) {
+            block.term[t] = matrixView(A->term[t], i, p, mc, kc);
+            block.sign[t] = A->sign[t];
+        }
+        S = matrixTake(&scratch, mc, kc);
+        matrixEvaluate(&block, S);
+        i = p = 0;
+        sign = 1;
+    }
+    for (int ir = 0; ir < mc; ir += GEMM_MR) {
+        int mr = mc - ir < GEMM_MR ? mc - ir : GEMM_MR;
+        const T* a = matrixRow(S, i + ir) + p;
+        for (int k = 0; k < kc; k++) {
+            int r = 0;
+            for (; r < mr; r++) {
+                packed[r] = sign * a[(size_t)r * S.ld + k];
             }
+            for (; r < GEMM_MR; r++) {
+                packed[r] = 0;
+            }
+            packed += GEMM_MR;
         }
     }
 }
 
-void matrixCopy(int h, int n, int iOffset, int jOffset, int** A, int** B) {
-    for (int i = 0; i < h; i++) {
-        for (int j = 0; j < h; j++) {
-            if (i + iOffset < n && j + jOffset < n) {
-                B[i][j] = A[i + iOffset][j + jOffset];
-            } else {
-                B[i][j] = 0; // Fill with 0 if out of bounds
+// Pack the kc x nc panel at (p, j) of the operand sum B into micro-panels of
+// GEMM_NR columns, stored row by row; columns past nc are filled with 0.
+// The terms of a sum are combined one micro-panel row at a time, in L1.
+template <typename T>
+static void gemmPackB(const MatrixSum<T>* B, int p, int j, int kc, int nc, T* packed) {
+    for (int jr = 0; jr < nc; jr += GEMM_NR(T)) {
+        int nr = nc - jr < GEMM_NR(T) ? nc - jr : GEMM_NR(T);
+        for (int k = 0; k < kc; k++) {
+            const T* b = matrixRow(B->term[0], p + k) + j + jr;
+            const int sign = B->sign[0];
+            int c = 0;
+            for (; c < nr; c++) {
+                packed[c] = sign * b[c];
             }
+            for (; c < GEMM_NR(T); c++) {
+                packed[c] = 0;
+            }
+            for (int t = 1; t < B->terms; t++) {
+                const T* y = matrixRow(B->term[t], p + k) + j + jr;
+                const int s = B->sign[t];
+                for (c = 0; c < nr; c++) {
+                    packed[c] += s * y[c];
+                }
+            }
+            packed += GEMM_NR(T);
         }
     }
 }
 
-void matrixStrassen(int threshold, int n, int** A, int** B, int** C) {
-    if (n <= threshold) {
-        matrixStandardMul(n, A, B, C);
-        return;
+// GEMM_MR x GEMM_NR tile of C (leading dimension ldc) = (first ? 0 : C) +
+// packed A micro-panel * packed B micro-panel, over kc steps
+template <typename T>
+static void gemmMicroKernel(int kc, const T* a, const T* b, T* c, int ldc, int first) {
+    typedef T Vec __attribute__((vector_size(GEMM_VEC_BYTES)));
+    const int vec = GEMM_VEC_BYTES / sizeof(T);
+    Vec c00 = {}, c01 = {}, c10 = {}, c11 = {}, c20 = {}, c21 = {};
+    Vec c30 = {}, c31 = {}, c40 = {}, c41 = {}, c50 = {}, c51 = {};
+    Vec b0, b1, ar;
+
+#define GEMM_UPDATE(r) \
+    ar = a[r] - (Vec){}; \
+    c##r##0 += ar * b0; \
+    c##r##1 += ar * b1;
+
+    for (int k = 0; k < kc; k++) {
+        b0 = *(const Vec*)b;
+        b1 = *(const Vec*)(b + vec);
+        GEMM_UPDATE(0) GEMM_UPDATE(1) GEMM_UPDATE(2)
+        GEMM_UPDATE(3) GEMM_UPDATE(4) GEMM_UPDATE(5)
+        a += GEMM_MR;
+        b += GEMM_NR(T);
     }
 
-    int h = (n + 1) / 2;
-
-    int** addTemp_1 = matrixAllocate(h);
-    int** addTemp_2 = matrixAllocate(h);
-    int** addTemp_3 = matrixAllocate(h);
-    int** addTemp_4 = matrixAllocate(h);
-    int** addTemp_5 = matrixAllocate(h);
-    int** addTemp_6 = matrixAllocate(h);
-    int** addTemp_7 = matrixAllocate(h);
-    int** addTemp_8 = matrixAllocate(h);
-    int** addTemp_9 = matrixAllocate(h);
-    int** addTemp_10 = matrixAllocate(h);
-
-    int** M1 = matrixAllocate(h);
-    int** M2 = matrixAllocate(h);
-    int** M3 = matrixAllocate(h);
-    int** M4 = matrixAllocate(h);
-    int** M5 = matrixAllocate(h);
-    int** M6 = matrixAllocate(h);
-    int** M7 = matrixAllocate(h);
-
-    int** A11 = matrixAllocate(h);
-    int** A12 = matrixAllocate(h);
-    int** A21 = matrixAllocate(h);
-    int** A22 = matrixAllocate(h);
-
-    int** B11 = matrixAllocate(h);
-    int** B12 = matrixAllocate(h);
-    int** B21 = matrixAllocate(h);
-    int** B22 = matrixAllocate(h);
-
-    matrixCopy(h, n, 0, 0, A, A11);
-    matrixCopy(h, n, 0, h, A, A12);
-    matrixCopy(h, n, h, 0, A, A21);
-    matrixCopy(h, n, h, h, A, A22);
-
-    matrixCopy(h, n, 0, 0, B, B11);
-    matrixCopy(h, n, 0, h, B, B12);
-    matrixCopy(h, n, h, 0, B, B21);
-    matrixCopy(h, n, h, h, B, B22);
+    // C rows are not aligned; memcpy compiles to unaligned vector moves
+#define GEMM_STORE(r) \
+    if (!first) { \
+        Vec t0, t1; \
+        memcpy(&t0, c + r * ldc, sizeof(Vec)); \
+        memcpy(&t1, c + r * ldc + vec, sizeof(Vec)); \
+        c##r##0 += t0; \
+        c##r##1 += t1; \
+    } \
+    memcpy(c + r * ldc, &c##r##0, sizeof(Vec)); \
+    memcpy(c + r * ldc + vec, &c##r##1, sizeof(Vec));
+
+    GEMM_STORE(0) GEMM_STORE(1) GEMM_STORE(2)
+    GEMM_STORE(3) GEMM_STORE(4) GEMM_STORE(5)
+#undef GEMM_UPDATE
+#undef GEMM_STORE
+}
+
+// C = A * B for operand sums A and B, which are formed while packing; the
+// packing buffers and scratch are taken from work, which must hold
+// gemmWorkspace(C.rows, C.cols, k) elements
+template <typename T>
+void matrixGemm(const MatrixSum<T>* A, const MatrixSum<T>* B, Matrix<T> C, T* work) {
+    int m = C.rows, n = C.cols, k = A->term[0].cols;
+    int mcMax = m < GEMM_MC ? m : GEMM_MC;
+    int ncMax = n < GEMM_NC ? n : GEMM_NC;
+    int kcMax = k < GEMM_KC ? k : GEMM_KC;
+    T* packedA = work;
+    T* packedB = packedA + matrixElements<T>(roundUp(mcMax, GEMM_MR), kcMax);
+    T* scratch = packedB + matrixElements<T>(kcMax, roundUp(ncMax, GEMM_NR(T)));
+    alignas(MATRIX_ALIGNMENT) T tile[GEMM_MR * GEMM_NR(T)];
+
+    for (int jc = 0; jc < n; jc += GEMM_NC) {
+        int nc = n - jc < GEMM_NC ? n - jc : GEMM_NC;
+        for (int pc = 0; pc < k; pc += GEMM_KC) {
+            int kc = k - pc < GEMM_KC ? k - pc : GEMM_KC;
+            gemmPackB(B, pc, jc, kc, nc, packedB);
+            for (int ic = 0; ic < m; ic += GEMM_MC) {
+                int mc = m - ic < GEMM_MC ? m - ic : GEMM_MC;
+                gemmPackA(A, ic, pc, mc, kc, packedA, scratch);
+                for (int jr = 0; jr < nc; jr += GEMM_NR(T)) {
+                    int nr = nc - jr < GEMM_NR(T) ? nc - jr : GEMM_NR(T);
+                    for (int ir = 0; ir < mc; ir += GEMM_MR) {
+                        int mr = mc - ir < GEMM_MR ? mc - ir : GEMM_MR;
+                        const T* a = packedA + (size_t)ir * kc;
+                        const T* b = packedB + (size_t)jr * kc;
+                        T* c = matrixRow(C, ic + ir) + jc + jr;
+                        if (mr == GEMM_MR && nr == GEMM_NR(T)) {
+                            gemmMicroKernel(kc, a, b, c, C.ld, pc == 0);
+                            continue;
+                        }
+                        // Partial tile at the edge of C: compute it in full,
+                        // then add the part that lies inside C
+                        gemmMicroKernel(kc, a, b, tile, GEMM_NR(T), 1);
+                        for (int r = 0; r < mr; r++) {
+                            for (int j = 0; j < nr; j++) {
+                                c[(size_t)r * C.ld + j] = (pc == 0 ? 0 : c[(size_t)r * C.ld + j]) + tile[r * GEMM_NR(T) + j];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
 
+// C = A * B with matrixGemm; each thread computes a band of rows of C, with
+// its own packing buffers
+template <typename T>
+void matrixStandardMul(Matrix<T> A, Matrix<T> B, Matrix<T> C) {
     #pragma omp parallel
     {
-        #pragma omp single
-        {
-            #pragma omp task
-            {
-                matrixAdd(h, A11, A22, addTemp_1);
-                matrixAdd(h, B11, B22, addTemp_2);
-                matrixStrassen(threshold, h, addTemp_1, addTemp_2, M1);
-            }
+        int threads = omp_get_num_threads();
+        int band = roundUp((C.rows + threads - 1) / threads, GEMM_MR);
+        int first = omp_get_thread_num() * band;
+        int rows = (C.rows - first < band) ? C.rows - first : band;
+        if (rows > 0) {
+            MatrixSum<T> SA = {1, {matrixView(A, first, 0, rows, A.cols)}, {1}};
+            MatrixSum<T> SB = {1, {B}, {1}};
+            T* work = alignedAllocate<T>(gemmWorkspace<T>(rows, C.cols, A.cols));
+            matrixGemm(&SA, &SB, matrixView(C, first, 0, rows, C.cols), work);
+            free(work);
+        }
+    }
+}
 
-            #pragma omp task
-            {
-                matrixAdd(h, A21, A22, addTemp_3);
-                matrixStrassen(threshold, h, addTemp_3, B11, M2);
-            }
+// Default number of recursion levels that run their seven products as
+// concurrent tasks; 7^2 = 49 tasks keep 8 ... 48 threads busy
+#ifndef STRASSEN_TASK_DEPTH
+#define STRASSEN_TASK_DEPTH 2
+#endif
 
-            #pragma omp task
-            {
-                matrixSub(h, B12, B22, addTemp_4);
-                matrixStrassen(threshold, h, A11, addTemp_4, M3);
-            }
+typedef struct StrassenParams {
+    int threshold;  // Sizes up to threshold use the standard multiply
+    int taskDepth;  // Levels 0 ... taskDepth-1 create tasks; deeper levels
+                    // run their products one after the other
+    int maxDepth;   // Strassen steps on any path, at most; products below
+                    // use the standard multiply whatever their size. Each
+                    // step adds to the floating-point error; -1 for no limit
+} StrassenParams;
 
-            #pragma omp task
-            {
-                matrixSub(h, B21, B11, addTemp_5);
-                matrixStrassen(threshold, h, A22, addTemp_5, M4);
-            }
+// Strassen-Winograd: 7 products and 15 additions per level
+//
+//   S1 = A21 + A22   T1 = B12 - B11   P1 = A11 B11   U2 = P1 + P6
+//   S2 = S1 - A11    T2 = B22 - T1    P2 = A12 B21   U3 = U2 + P7
+//   S3 = A11 - A21   T3 = B22 - B12   P3 = S4 B22    C11 = P1 + P2
+//   S4 = A12 - S2    T4 = T2 - B21    P4 = A22 T4    C12 = U2 + P5 + P3
+//                                     P5 = S1 T1     C21 = U3 - P4
+//                                     P6 = S2 T2     C22 = U3 + P5
+//                                     P7 = S3 T3
+//
+// The S and T operands are passed down as MatrixSums of quadrants of A and
+// B. If the level below is a base case, matrixGemm forms them while packing
+// and they are never stored; otherwise each is evaluated into an operand
+// buffer in one pass. The C quadrants are combined in one pass as well.
 
-            #pragma omp task
-            {
-                matrixAdd(h, A11, A12, addTemp_6);
-                matrixStrassen(threshold, h, addTemp_6, B22, M5);
-            }
+// A product is split in half along its largest dimension, without a
+// Strassen step, if that dimension is at least twice the smallest one. This
+// takes skinny shapes towards square ones, where a Strassen step pays off.
+#define STRASSEN_SPLIT_NONE 0
+#define STRASSEN_SPLIT_M    1   // Rows of A and C
+#define STRASSEN_SPLIT_N    2   // Columns of B and C
+#define STRASSEN_SPLIT_K    3   // Columns of A and rows of B; the two halves
+                                // of the product are added
 
-            #pragma omp task
-            {
-                matrixSub(h, A21, A11, addTemp_7);
-                matrixAdd(h, B11, B12, addTemp_8);
-                matrixStrassen(threshold, h, addTemp_7, addTemp_8, M6);
-            }
+static int strassenSplit(int m, int n, int k) {
+    int largest = m > n ? (m > k ? m : k) : (n > k ? n : k);
+    int smallest = m < n ? (m < k ? m : k) : (n < k ? n : k);
+    if (largest < 2 * smallest) return STRASSEN_SPLIT_NONE;
+    if (largest == m) return STRASSEN_SPLIT_M;
+    if (largest == n) return STRASSEN_SPLIT_N;
+    return STRASSEN_SPLIT_K;
+}
 
-            #pragma omp task
-            {
-                matrixSub(h, A12, A22, addTemp_9);
-                matrixAdd(h, B21, B22, addTemp_10);
-                matrixStrassen(threshold, h, addTemp_9, addTemp_10, M7);
-            }
+// An m x k times k x n product below level Strassen steps is a base case
+// once any dimension is down to the threshold, or the depth limit is reached
+static inline int strassenBaseCase(const StrassenParams* params, int m, int n, int k, int level) {
+    if (params->maxDepth >= 0 && level >= params->maxDepth) return 1;
+    return m <= params->threshold || n <= params->threshold || k <= params->threshold;
+}
 
-            #pragma omp taskwait
+// Number of workspace elements matrixStrassen needs for an m x k times k x n
+// product at recursion level depth, below level Strassen steps:
+//   base case        - packing buffers of matrixGemm
+//   split            - the two halves, side by side if they run as tasks,
+//                      else one after the other; plus an m x n buffer for
+//                      the second half of a split of k
+//   odd dimension    - the product of the even leading parts; the peeled
+//                      rows and columns need no workspace
+//   tasking level    - P1 ... P7 and the 8 operand buffers of the tasks, plus
+//                      one slice per task
+//   sequential level - P1 and two operand buffers, reused by all seven
+//                      products, plus one slice for the level below
+// Operand buffers are only needed if the level below is not a base case.
+template <typename T>
+size_t strassenWorkspace(const StrassenParams* params, int m, int n, int k, int depth, int level) {
+    if (strassenBaseCase(params, m, n, k, level)) return gemmWorkspace<T>(m, n, k);
+    int split = strassenSplit(m, n, k);
+    if (split != STRASSEN_SPLIT_NONE) {
+        size_t first, second, sum = 0;
+        if (split == STRASSEN_SPLIT_M) {
+            first = strassenWorkspace<T>(params, m / 2, n, k, depth + 1, level);
+            second = strassenWorkspace<T>(params, m - m / 2, n, k, depth + 1, level);
+        } else if (split == STRASSEN_SPLIT_N) {
+            first = strassenWorkspace<T>(params, m, n / 2, k, depth + 1, level);
+            second = strassenWorkspace<T>(params, m, n - n / 2, k, depth + 1, level);
+        } else {
+            first = strassenWorkspace<T>(params, m, n, k / 2, depth + 1, level);
+            second = strassenWorkspace<T>(params, m, n, k - k / 2, depth + 1, level);
+            sum = matrixElements<T>(m, n);
         }
+        if (depth < params->taskDepth) return sum + first + second;
+        return sum + (first > second ? first : second);
+    }
+    if ((m | n | k) & 1) {
+        return strassenWorkspace<T>(params, m & ~1, n & ~1, k & ~1, depth, level);
+    }
+    int mh = m / 2, nh = n / 2, kh = k / 2;
+    int evaluate = !strassenBaseCase(params, mh, nh, kh, level + 1);
+    size_t child = strassenWorkspace<T>(params, mh, nh, kh, depth + 1, level + 1);
+    size_t operands = matrixElements<T>(mh, kh) + matrixElements<T>(kh, nh);
+    if (depth < params->taskDepth) {
+        return 7 * matrixElements<T>(mh, nh) + (evaluate ? 4 * operands : 0) + 7 * child;
     }
+    return matrixElements<T>(mh, nh) + (evaluate ? operands : 0) + child;
+}
+
+// Operand S of a product one level down: passed on as it is if that level is
+// a base case, else evaluated into X
+template <typename T>
+static MatrixSum<T> strassenOperand(const MatrixSum<T>& S, int evaluate, Matrix<T> X) {
+    if (!evaluate || S.terms == 1) return S;
+    matrixEvaluate(&S, X);
+    MatrixSum<T> E = {1, {X}, {1}};
+    return E;
+}
 
-    for (int i = 0; i < h; i++) {
-        for (int j = 0; j < h; j++) {
-            C[i][j] = M1[i][j] + M4[i][j] - M5[i][j] + M7[i][j];
-            if (j + h < n) {
-                C[i][j + h] = M3[i][j] + M5[i][j];
+// Complete C = A * B when some dimensions are odd and the product of the
+// even leading parts of A and B is already in the top left of C (dynamic
+// peeling): add the rank-1 product of the last column of A and the last row
+// of B to it if k is odd, then compute the last column of C if n is odd and
+// the rest of its last row if m is odd.
+template <typename T>
+static void strassenPeel(Matrix<T> A, Matrix<T> B, Matrix<T> C) {
+    int m = C.rows, n = C.cols, k = A.cols;
+    int me = m & ~1, ne = n & ~1;
+    if (k & 1) {
+        const T* b = matrixRow(B, k - 1);
+        for (int i = 0; i < me; i++) {
+            const T a = matrixRow(A, i)[k - 1];
+            T* c = matrixRow(C, i);
+            for (int j = 0; j < ne; j++) {
+                c[j] += a * b[j];
             }
-            if (i + h < n) {
-                C[i + h][j] = M2[i][j] + M4[i][j];
+        }
+    }
+    if (n & 1) {
+        for (int i = 0; i < m; i++) {
+            const T* a = matrixRow(A, i);
+            T sum = 0;
+            for (int p = 0; p < k; p++) {
+                sum += a[p] * matrixRow(B, p)[n - 1];
             }
-            if (i + h < n && j + h < n) {
-                C[i + h][j + h] = M1[i][j] - M2[i][j] + M3[i][j] + M6[i][j];
+            matrixRow(C, i)[n - 1] = sum;
+        }
+    }
+    if (m & 1) {
+        const T* a = matrixRow(A, m - 1);
+        T* c = matrixRow(C, m - 1);
+        for (int j = 0; j < ne; j++) {
+            c[j] = 0;
+        }
+        for (int p = 0; p < k; p++) {
+            const T* b = matrixRow(B, p);
+            for (int j = 0; j < ne; j++) {
+                c[j] += a[p] * b[j];
+            }
+        }
+    }
+}
+
+template <typename T>
+static void strassenRecurse(const StrassenParams* params, int depth, int level, MatrixSum<T> A, MatrixSum<T> B, Matrix<T> C, T* work);
+
+// C = A * B as two half-size products, along the dimension chosen by
+// strassenSplit; run as two tasks on tasking levels
+template <typename T>
+static void strassenSplitStep(const StrassenParams* params, int depth, int level, int split, Matrix<T> a, Matrix<T> b, Matrix<T> C, T* work) {
+    int m = C.rows, n = C.cols, k = a.cols;
+    Matrix<T> A1 = a, A2 = a, B1 = b, B2 = b, C1 = C, C2 = C;
+    if (split == STRASSEN_SPLIT_M) {
+        A1 = matrixView(a, 0, 0, m / 2, k);
+        A2 = matrixView(a, m / 2, 0, m - m / 2, k);
+        C1 = matrixView(C, 0, 0, m / 2, n);
+        C2 = matrixView(C, m / 2, 0, m - m / 2, n);
+    } else if (split == STRASSEN_SPLIT_N) {
+        B1 = matrixView(b, 0, 0, k, n / 2);
+        B2 = matrixView(b, 0, n / 2, k, n - n / 2);
+        C1 = matrixView(C, 0, 0, m, n / 2);
+        C2 = matrixView(C, 0, n / 2, m, n - n / 2);
+    } else {
+        A1 = matrixView(a, 0, 0, m, k / 2);
+        A2 = matrixView(a, 0, k / 2, m, k - k / 2);
+        B1 = matrixView(b, 0, 0, k / 2, n);
+        B2 = matrixView(b, k / 2, 0, k - k / 2, n);
+        C2 = matrixTake(&work, m, n);
+    }
+    MatrixSum<T> SA1 = {1, {A1}, {1}};
+    MatrixSum<T> SA2 = {1, {A2}, {1}};
+    MatrixSum<T> SB1 = {1, {B1}, {1}};
+    MatrixSum<T> SB2 = {1, {B2}, {1}};
+
+    if (depth >= params->taskDepth) {
+        strassenRecurse(params, depth + 1, level, SA1, SB1, C1, work);
+        strassenRecurse(params, depth + 1, level, SA2, SB2, C2, work);
+    } else {
+        int last = depth + 1 >= params->taskDepth;
+        int priority = (depth == 0) ? 1 : 0;
+        T* work2 = work + strassenWorkspace<T>(params, C1.rows, C1.cols, A1.cols, depth + 1, level);
+
+        #pragma omp task final(last) mergeable priority(priority)
+        {
+            strassenRecurse(params, depth + 1, level, SA1, SB1, C1, work);
+        }
+
+        #pragma omp task final(last) mergeable priority(priority)
+        {
+            strassenRecurse(params, depth + 1, level, SA2, SB2, C2, work2);
+        }
+
+        #pragma omp taskwait
+    }
+
+    if (split == STRASSEN_SPLIT_K) {
+        matrixAdd(C, C2, C);
+    }
+}
+
+template <typename T>
+static void strassenRecurse(const StrassenParams* params, int depth, int level, MatrixSum<T> A, MatrixSum<T> B, Matrix<T> C, T* work) {
+    int m = C.rows, n = C.cols, k = A.term[0].cols;
+    if (strassenBaseCase(params, m, n, k, level)) {
+        matrixGemm(&A, &B, C, work);
+        return;
+    }
+
+    // Above the base case the operands are always plain matrices
+    Matrix<T> a = A.term[0];
+    Matrix<T> b = B.term[0];
+
+    int split = strassenSplit(m, n, k);
+    if (split != STRASSEN_SPLIT_NONE) {
+        strassenSplitStep(params, depth, level, split, a, b, C, work);
+        return;
+    }
+
+    if ((m | n | k) & 1) {
+        // Multiply the even leading parts, then peel off the odd row and
+        // column of each dimension
+        MatrixSum<T> SA = {1, {matrixView(a, 0, 0, m & ~1, k & ~1)}, {1}};
+        MatrixSum<T> SB = {1, {matrixView(b, 0, 0, k & ~1, n & ~1)}, {1}};
+        strassenRecurse(params, depth, level, SA, SB, matrixView(C, 0, 0, m & ~1, n & ~1), work);
+        strassenPeel(a, b, C);
+        return;
+    }
+
+    int mh = m / 2, nh = n / 2, kh = k / 2;
+    int evaluate = !strassenBaseCase(params, mh, nh, kh, level + 1);
+    size_t child = strassenWorkspace<T>(params, mh, nh, kh, depth + 1, level + 1);
+
+    Matrix<T> A11 = matrixView(a, 0, 0, mh, kh);
+    Matrix<T> A12 = matrixView(a, 0, kh, mh, kh);
+    Matrix<T> A21 = matrixView(a, mh, 0, mh, kh);
+    Matrix<T> A22 = matrixView(a, mh, kh, mh, kh);
+
+    Matrix<T> B11 = matrixView(b, 0, 0, kh, nh);
+    Matrix<T> B12 = matrixView(b, 0, nh, kh, nh);
+    Matrix<T> B21 = matrixView(b, kh, 0, kh, nh);
+    Matrix<T> B22 = matrixView(b, kh, nh, kh, nh);
+
+    Matrix<T> C11 = matrixView(C, 0, 0, mh, nh);
+    Matrix<T> C12 = matrixView(C, 0, nh, mh, nh);
+    Matrix<T> C21 = matrixView(C, mh, 0, mh, nh);
+    Matrix<T> C22 = matrixView(C, mh, nh, mh, nh);
+
+    MatrixSum<T> a11 = {1, {A11}, {1}};
+    MatrixSum<T> a12 = {1, {A12}, {1}};
+    MatrixSum<T> a22 = {1, {A22}, {1}};
+    MatrixSum<T> b11 = {1, {B11}, {1}};
+    MatrixSum<T> b21 = {1, {B21}, {1}};
+    MatrixSum<T> b22 = {1, {B22}, {1}};
+
+    MatrixSum<T> S1 = {2, {A21, A22}, {1, 1}};
+    MatrixSum<T> S2 = {3, {A21, A22, A11}, {1, 1, -1}};
+    MatrixSum<T> S3 = {2, {A11, A21}, {1, -1}};
+    MatrixSum<T> S4 = {4, {A12, A21, A22, A11}, {1, -1, -1, 1}};
+
+    MatrixSum<T> T1 = {2, {B12, B11}, {1, -1}};
+    MatrixSum<T> T2 = {3, {B22, B12, B11}, {1, -1, 1}};
+    MatrixSum<T> T3 = {2, {B22, B12}, {1, -1}};
+    MatrixSum<T> T4 = {4, {B22, B12, B11, B21}, {1, -1, 1, -1}};
+
+    Matrix<T> none = {NULL, 0, 0, 0};
+
+    if (depth >= params->taskDepth) {
+        // One product at a time, using the C quadrants as storage for the
+        // products (schedule of Boyer, Dumas, Pernet and Zhou, 2009)
+        Matrix<T> P1 = matrixTake(&work, mh, nh);
+        Matrix<T> X = evaluate ? matrixTake(&work, mh, kh) : none;
+        Matrix<T> Y = evaluate ? matrixTake(&work, kh, nh) : none;
+
+        strassenRecurse(params, depth + 1, level + 1, strassenOperand(S3, evaluate, X), strassenOperand(T3, evaluate, Y), C21, work);  // P7
+        strassenRecurse(params, depth + 1, level + 1, strassenOperand(S1, evaluate, X), strassenOperand(T1, evaluate, Y), C22, work);  // P5
+        strassenRecurse(params, depth + 1, level + 1, strassenOperand(S2, evaluate, X), strassenOperand(T2, evaluate, Y), C12, work);  // P6
+        strassenRecurse(params, depth + 1, level + 1, strassenOperand(S4, evaluate, X), b22, C11, work);                               // P3
+        strassenRecurse(params, depth + 1, level + 1, a11, b11, P1, work);
+
+        for (int i = 0; i < mh; i++) {
+            const T* p1 = matrixRow(P1, i);
+            const T* p3 = matrixRow(C11, i);
+            T* c12 = matrixRow(C12, i);
+            T* c21 = matrixRow(C21, i);
+            T* c22 = matrixRow(C22, i);
+            for (int j = 0; j < nh; j++) {
+                T u2 = p1[j] + c12[j];
+                T u3 = u2 + c21[j];
+                c12[j] = u2 + c22[j] + p3[j];
+                c21[j] = u3;
+                c22[j] = u3 + c22[j];
             }
         }
+
+        strassenRecurse(params, depth + 1, level + 1, a22, strassenOperand(T4, evaluate, Y), C11, work);                               // P4
+        matrixSub(C21, C11, C21);
+        strassenRecurse(params, depth + 1, level + 1, a12, b21, C11, work);                                                            // P2
+        matrixAdd(P1, C11, C11);
+        return;
+    }
+
+    Matrix<T> P1 = matrixTake(&work, mh, nh);
+    Matrix<T> P2 = matrixTake(&work, mh, nh);
+    Matrix<T> P3 = matrixTake(&work, mh, nh);
+    Matrix<T> P4 = matrixTake(&work, mh, nh);
+    Matrix<T> P5 = matrixTake(&work, mh, nh);
+    Matrix<T> P6 = matrixTake(&work, mh, nh);
+    Matrix<T> P7 = matrixTake(&work, mh, nh);
+
+    Matrix<T> X3 = evaluate ? matrixTake(&work, mh, kh) : none;
+    Matrix<T> Y4 = evaluate ? matrixTake(&work, kh, nh) : none;
+    Matrix<T> X5 = evaluate ? matrixTake(&work, mh, kh) : none;
+    Matrix<T> Y5 = evaluate ? matrixTake(&work, kh, nh) : none;
+    Matrix<T> X6 = evaluate ? matrixTake(&work, mh, kh) : none;
+    Matrix<T> Y6 = evaluate ? matrixTake(&work, kh, nh) : none;
+    Matrix<T> X7 = evaluate ? matrixTake(&work, mh, kh) : none;
+    Matrix<T> Y7 = evaluate ? matrixTake(&work, kh, nh) : none;
+
+    // The tasks of the last tasking level are final, so the runtime knows
+    // that nothing below them is deferred. With OMP_MAX_TASK_PRIORITY > 0 the
+    // seven largest subtrees (level 0) are started before any deeper task;
+    // deeper levels keep priority 0, since libgomp (GCC 12) crashes in
+    // taskwait when nested tasks use different nonzero priorities.
+    // The workspace of the task computing P<i> starts at work + (i-1) * child
+    int last = depth + 1 >= params->taskDepth;
+    int priority = (depth == 0) ? 1 : 0;
+
+    #pragma omp task final(last) mergeable priority(priority)
+    {
+        strassenRecurse(params, depth + 1, level + 1, a11, b11, P1, work);
+    }
+
+    #pragma omp task final(last) mergeable priority(priority)
+    {
+        strassenRecurse(params, depth + 1, level + 1, a12, b21, P2, work + child);
+    }
+
+    #pragma omp task final(last) mergeable priority(priority)
+    {
+        strassenRecurse(params, depth + 1, level + 1, strassenOperand(S4, evaluate, X3), b22, P3, work + 2 * child);
+    }
+
+    #pragma omp task final(last) mergeable priority(priority)
+    {
+        strassenRecurse(params, depth + 1, level + 1, a22, strassenOperand(T4, evaluate, Y4), P4, work + 3 * child);
+    }
+
+    #pragma omp task final(last) mergeable priority(priority)
+    {
+        strassenRecurse(params, depth + 1, level + 1, strassenOperand(S1, evaluate, X5), strassenOperand(T1, evaluate, Y5), P5, work + 4 * child);
+    }
+
+    #pragma omp task final(last) mergeable priority(priority)
+    {
+        strassenRecurse(params, depth + 1, level + 1, strassenOperand(S2, evaluate, X6), strassenOperand(T2, evaluate, Y6), P6, work + 5 * child);
+    }
+
+    #pragma omp task final(last) mergeable priority(priority)
+    {
+        strassenRecurse(params, depth + 1, level + 1, strassenOperand(S3, evaluate, X7), strassenOperand(T3, evaluate, Y7), P7, work + 6 * child);
+    }
+
+    #pragma omp taskwait
+
+    for (int i = 0; i < mh; i++) {
+        const T* p1 = matrixRow(P1, i);
+        const T* p2 = matrixRow(P2, i);
+        const T* p3 = matrixRow(P3, i);
+        const T* p4 = matrixRow(P4, i);
+        const T* p5 = matrixRow(P5, i);
+        const T* p6 = matrixRow(P6, i);
+        const T* p7 = matrixRow(P7, i);
+        T* c11 = matrixRow(C11, i);
+        T* c12 = matrixRow(C12, i);
+        T* c21 = matrixRow(C21, i);
+        T* c22 = matrixRow(C22, i);
+        for (int j = 0; j < nh; j++) {
+            T u2 = p1[j] + p6[j];
+            T u3 = u2 + p7[j];
+            c11[j] = p1[j] + p2[j];
+            c12[j] = u2 + p5[j] + p3[j];
+            c21[j] = u3 - p4[j];
+            c22[j] = u3 + p5[j];
+        }
     }
+}
 
-    matrixFree(addTemp_1, h);
-    matrixFree(addTemp_2, h);
-    matrixFree(addTemp_3, h);
-    matrixFree(addTemp_4, h);
-    matrixFree(addTemp_5, h);
-    matrixFree(addTemp_6, h);
-    matrixFree(addTemp_7, h);
-    matrixFree(addTemp_8, h);
-    matrixFree(addTemp_9, h);
-    matrixFree(addTemp_10, h);
+// C = A * B for an m x k matrix A and a k x n matrix B, with all temporaries
+// taken from work, which must hold strassenWorkspace(params, m, n, k, 0, 0)
+// elements. Must be called from inside a parallel region (by a single
+// thread) for the tasks to run concurrently.
+template <typename T>
+void matrixStrassen(const StrassenParams* params, Matrix<T> A, Matrix<T> B, Matrix<T> C, T* work) {
+    MatrixSum<T> SA = {1, {A}, {1}};
+    MatrixSum<T> SB = {1, {B}, {1}};
+    strassenRecurse(params, 0, 0, SA, SB, C, work);
+}
 
-    matrixFree(M1, h);
-    matrixFree(M2, h);
-    matrixFree(M3, h);
-    matrixFree(M4, h);
-    matrixFree(M5, h);
-    matrixFree(M6, h);
-    matrixFree(M7, h);
+// Name of element type T, as given with -t and used in the tuning file
+template <typename T> const char* elementName();
+template <> const char* elementName<int32_t>() { return "int32"; }
+template <> const char* elementName<int64_t>() { return "int64"; }
+template <> const char* elementName<float>() { return "float"; }
+template <> const char* elementName<double>() { return "double"; }
 
-    matrixFree(A11, h);
-    matrixFree(A12, h);
-    matrixFree(A21, h);
-    matrixFree(A22, h);
+// Crossover threshold and thread count for this machine and element type,
+// found by strassenAutotune and kept in a tuning file of "key value" lines
+// (<type>.threshold and <type>.threads), which later runs load at startup
+#define STRASSEN_TUNING_FILE "strassen_tuning.txt"
+#define STRASSEN_TUNING_ENTRIES 32
+#define STRASSEN_DEFAULT_THRESHOLD 64
 
-    matrixFree(B11, h);
-    matrixFree(B12, h);
-    matrixFree(B21, h);
-    matrixFree(B22, h);
+// Sizes benchmarked for the crossover, and the product timed for the thread
+// count
+#define STRASSEN_TUNE_MIN 32
+#define STRASSEN_TUNE_MAX 1024
+#define STRASSEN_TUNE_SIZE 1024
+
+typedef struct StrassenTuning {
+    int threshold;
+    int threads;
+} StrassenTuning;
+
+// Load the tuning of element type from path; entries missing from the file
+// keep their value. Returns 0 if the file cannot be read.
+int strassenLoadTuning(const char* path, const char* type, StrassenTuning* tuning) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) return 0;
+    char key[64], threshold[64], threads[64];
+    snprintf(threshold, sizeof(threshold), "%s.threshold", type);
+    snprintf(threads, sizeof(threads), "%s.threads", type);
+    int value;
+    while (fscanf(file, "%63s %d", key, &value) == 2) {
+        if (strcmp(key, threshold) == 0 && value > 0) tuning->threshold = value;
+        if (strcmp(key, threads) == 0 && value > 0) tuning->threads = value;
+    }
+    fclose(file);
+    return 1;
 }
 
-int matrixCompare(int n, int** A, int** B) {
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < n; j++) {
-            if (A[i][j] != B[i][j]) return 0;
+// Write the tuning of element type to path, keeping the entries of other
+// types
+int strassenSaveTuning(const char* path, const char* type, const StrassenTuning* tuning) {
+    char keys[STRASSEN_TUNING_ENTRIES][64];
+    int values[STRASSEN_TUNING_ENTRIES];
+    int entries = 0;
+    size_t prefix = strlen(type);
+    FILE* file = fopen(path, "r");
+    if (file != NULL) {
+        while (entries < STRASSEN_TUNING_ENTRIES && fscanf(file, "%63s %d", keys[entries], &values[entries]) == 2) {
+            if (strncmp(keys[entries], type, prefix) != 0 || keys[entries][prefix] != '.') entries++;
         }
+        fclose(file);
     }
+    file = fopen(path, "w");
+    if (file == NULL) return 0;
+    for (int e = 0; e < entries; e++) {
+        fprintf(file, "%s %d\n", keys[e], values[e]);
+    }
+    fprintf(file, "%s.threshold %d\n", type, tuning->threshold);
+    fprintf(file, "%s.threads %d\n", type, tuning->threads);
+    fclose(file);
     return 1;
 }
 
-int main(int argc, char* argv[]) {
-    struct timespec start, stop, start_standard, stop_standard;
-    double total_time, total_time_standard;
+// Shortest of several runs of matrixStrassen with the given number of
+// threads; runs are repeated for at least 0.1 s and at least 3 times
+template <typename T>
+static double strassenTime(const StrassenParams* params, int threads, Matrix<T> A, Matrix<T> B, Matrix<T> C, T* work) {
+    double best = 0, total = 0;
+    for (int run = 0; run < 3 || total < 0.1; run++) {
+        double t = omp_get_wtime();
+        #pragma omp parallel num_threads(threads)
+        {
+            #pragma omp single
+            {
+                matrixStrassen(params, A, B, C, work);
+            }
+        }
+        t = omp_get_wtime() - t;
+        if (run == 0 || t < best) best = t;
+        total += t;
+    }
+    return best;
+}
 
-    if (argc != 3) {
-        printf("Need two integers as input \n");
-        printf("Use: <executable_name> <log_2(list_size)> <log_2(num_threads)>\n");
-        exit(0);
+// Benchmark the base case against one Strassen level over it at sizes
+// STRASSEN_TUNE_MIN ... STRASSEN_TUNE_MAX, on one thread, and take as
+// threshold the largest size below the first one where the Strassen level
+// wins. Then time a STRASSEN_TUNE_SIZE product with that threshold on 1, 2,
+// 4, ... threads, up to the number of processors, and take the fastest.
+template <typename T>
+StrassenTuning strassenAutotune(void) {
+    StrassenTuning tuning;
+    StrassenParams params;
+    params.taskDepth = 0;
+    params.maxDepth = -1;
+
+    tuning.threshold = STRASSEN_TUNE_MAX;
+    printf("%8s %12s %12s\n", "size", "gemm (sec)", "level (sec)");
+    for (int s = STRASSEN_TUNE_MIN; s <= STRASSEN_TUNE_MAX; s *= 2) {
+        Matrix<T> A = matrixAllocate<T>(s, s);
+        Matrix<T> B = matrixAllocate<T>(s, s);
+        Matrix<T> C = matrixAllocate<T>(s, s);
+        matrixRand(A, MATRIX_SEED_A);
+        matrixRand(B, MATRIX_SEED_B);
+        params.threshold = s / 2;
+        size_t levelWork = strassenWorkspace<T>(&params, s, s, s, 0, 0);
+        T* work = alignedAllocate<T>(levelWork > gemmWorkspace<T>(s, s, s) ? levelWork : gemmWorkspace<T>(s, s, s));
+
+        double level = strassenTime(&params, 1, A, B, C, work);
+        params.threshold = s;
+        double gemm = strassenTime(&params, 1, A, B, C, work);
+        printf("%8d %12.6f %12.6f\n", s, gemm, level);
+
+        matrixFree(A);
+        matrixFree(B);
+        matrixFree(C);
+        free(work);
+        if (level < gemm) {
+            tuning.threshold = s / 2;
+            break;
+        }
+    }
+
+    int n = STRASSEN_TUNE_SIZE;
+    Matrix<T> A = matrixAllocate<T>(n, n);
+    Matrix<T> B = matrixAllocate<T>(n, n);
+    Matrix<T> C = matrixAllocate<T>(n, n);
+    matrixRand(A, MATRIX_SEED_A);
+    matrixRand(B, MATRIX_SEED_B);
+    params.threshold = tuning.threshold;
+    params.taskDepth = STRASSEN_TASK_DEPTH;
+    T* work = alignedAllocate<T>(strassenWorkspace<T>(&params, n, n, n, 0, 0));
+
+    int procs = omp_get_num_procs();
+    double best = 0;
+    printf("%8s %12s\n", "threads", "time (sec)");
+    for (int threads = 1; ; threads *= 2) {
+        if (threads > procs) threads = procs;
+        double t = strassenTime(&params, threads, A, B, C, work);
+        printf("%8d %12.6f\n", threads, t);
+        if (threads == 1 || t < best) {
+            best = t;
+            tuning.threads = threads;
+        }
+        if (threads == procs) break;
     }
 
-    int n = (1 << atoi(argv[1]));
-    int threshold = (1 << atoi(argv[2]));
+    matrixFree(A);
+    matrixFree(B);
+    matrixFree(C);
+    free(work);
+    return tuning;
+}
 
-    int** A = matrixAllocate(n);
-    int** B = matrixAllocate(n);
-    int** C = matrixAllocate(n);
-    int** Cseq = matrixAllocate(n);
+template <typename T>
+int matrixCompare(Matrix<T> A, Matrix<T> B) {
+    int mismatch = 0;
+    #pragma omp parallel for schedule(static) reduction(|:mismatch)
+    for (int i = 0; i < A.rows; i++) {
+        const T* a = matrixRow(A, i);
+        const T* b = matrixRow(B, i);
+        for (int j = 0; j < A.cols; j++) {
+            mismatch |= (a[j] != b[j]);
+        }
+    }
+    return !mismatch;
+}
+
+// Error of C relative to the reference R in the Frobenius norm,
+// ||C - R|| / ||R||, accumulated in double precision
+template <typename T>
+double matrixRelativeError(Matrix<T> C, Matrix<T> R) {
+    double diff = 0, norm = 0;
+    #pragma omp parallel for schedule(static) reduction(+:diff, norm)
+    for (int i = 0; i < R.rows; i++) {
+        const T* c = matrixRow(C, i);
+        const T* r = matrixRow(R, i);
+        for (int j = 0; j < R.cols; j++) {
+            double d = (double)c[j] - (double)r[j];
+            diff += d * d;
+            norm += (double)r[j] * (double)r[j];
+        }
+    }
+    return (norm > 0) ? sqrt(diff / norm) : sqrt(diff);
+}
 
-    matrixRand(n, A);
-    matrixRand(n, B);
+// Number of random vectors of Freivalds' check, and the seed they are drawn
+// from
+#define FREIVALDS_VECTORS 8
+#define FREIVALDS_SEED 3
+
+// Y = M X for the FREIVALDS_VECTORS columns of X, stored row by row. Each
+// row of M is read once for all vectors.
+template <typename T, typename Acc>
+static void freivaldsMul(Matrix<T> M, const Acc* X, Acc* Y) {
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < M.rows; i++) {
+        const T* m = matrixRow(M, i);
+        Acc y[FREIVALDS_VECTORS] = {};
+        for (int j = 0; j < M.cols; j++) {
+            const Acc mij = (Acc)m[j];
+            const Acc* x = X + (size_t)j * FREIVALDS_VECTORS;
+            for (int v = 0; v < FREIVALDS_VECTORS; v++) {
+                y[v] += mij * x[v];
+            }
+        }
+        for (int v = 0; v < FREIVALDS_VECTORS; v++) {
+            Y[(size_t)i * FREIVALDS_VECTORS + v] = y[v];
+        }
+    }
+}
+
+// Freivalds' check of C = A * B in O(mk + kn + mn) instead of a reference
+// multiply: compare A (B X) with C X for FREIVALDS_VECTORS random vectors X.
+//
+// Integer products are checked exactly, in unsigned arithmetic modulo 2^64
+// reduced to the width of T, which is how the sums of C wrap; the entries
+// of X are random 64-bit values, so a wrong C passes a vector with
+// probability at most 1/2, and usually far less. The result is 1 if any
+// entry differs, else 0.
+//
+// Floating-point products are checked in double precision with entries of
+// X in [-1, 1); the result, ||C X - A (B X)|| / ||A (B X)||, estimates the
+// relative Frobenius error of C that matrixRelativeError computes.
+template <typename T>
+double matrixFreivalds(Matrix<T> A, Matrix<T> B, Matrix<T> C, unsigned long long seed) {
+    typedef typename std::conditional<std::numeric_limits<T>::is_integer, unsigned long long, double>::type Acc;
+    typedef typename std::conditional<std::numeric_limits<T>::is_integer, T, double>::type Word;
+    int m = C.rows, n = C.cols, k = A.cols;
+    Acc* X = alignedAllocate<Acc>((size_t)n * FREIVALDS_VECTORS);
+    Acc* Y = alignedAllocate<Acc>((size_t)k * FREIVALDS_VECTORS);
+    Acc* Z = alignedAllocate<Acc>((size_t)m * FREIVALDS_VECTORS);
+    Acc* W = alignedAllocate<Acc>((size_t)m * FREIVALDS_VECTORS);
+
+    for (size_t j = 0; j < (size_t)n * FREIVALDS_VECTORS; j++) {
+        unsigned long long r = mix64(seed * 0x2545f4914f6cdd1dULL + j);
+        X[j] = std::numeric_limits<T>::is_integer ? (Acc)r : (Acc)unitRandom(r);
+    }
+    freivaldsMul(B, X, Y);
+    freivaldsMul(A, Y, Z);
+    freivaldsMul(C, X, W);
+
+    double diff = 0, norm = 0;
+    int mismatch = 0;
+    #pragma omp parallel for schedule(static) reduction(+:diff, norm) reduction(|:mismatch)
+    for (size_t i = 0; i < (size_t)m * FREIVALDS_VECTORS; i++) {
+        if (std::numeric_limits<T>::is_integer) {
+            mismatch |= ((Word)Z[i] != (Word)W[i]);
+        } else {
+            double d = (double)W[i] - (double)Z[i];
+            diff += d * d;
+            norm += (double)Z[i] * (double)Z[i];
+        }
+    }
+
+    free(X);
+    free(Y);
+    free(Z);
+    free(W);
+    if (std::numeric_limits<T>::is_integer) return mismatch;
+    return (norm > 0) ? sqrt(diff / norm) : sqrt(diff);
+}
+
+// Verification of the product
+#define CHECK_NONE      0       // no verification
+#define CHECK_FAST      1       // Freivalds' check, O(n^2)
+#define CHECK_FULL      2       // compare with the standard multiply, O(n^3)
+
+// Command line of a run
+typedef struct Options {
+    int m, n, k;            // Matrix sizes
+    int threshold;          // log_2(threshold), or -1 for the tuned value
+    int taskDepth;
+    int maxDepth;           // Strassen depth limit; -1 for none
+    int threads;            // Number of threads; 0 for the tuned value
+    int autotune;           // Tune threshold and threads before the run
+    const char* tuningFile;
+    int check;              // Verification mode, CHECK_*
+    int standard;           // Time the standard multiply even if not checking
+    double tolerance;       // Largest relative error accepted for floating-point
+                            // types; negative for sqrt(machine epsilon)
+} Options;
+
+template <typename T>
+int run(const Options* options) {
+    struct timespec start, stop, start_standard, stop_standard, start_check, stop_check;
+    double total_time, total_time_standard = 0, total_time_check;
+    const char* check_names[] = {"none", "fast", "full"};
+    const char* type = elementName<T>();
+    int m = options->m, n = options->n, k = options->k;
+
+    // Tuned values, or defaults if there is no tuning file yet
+    StrassenTuning tuning;
+    tuning.threshold = STRASSEN_DEFAULT_THRESHOLD;
+    tuning.threads = omp_get_max_threads();
+    if (options->autotune) {
+        tuning = strassenAutotune<T>();
+        if (!strassenSaveTuning(options->tuningFile, type, &tuning)) {
+            printf("Unable to write tuning file %s\n", options->tuningFile);
+        }
+        printf("Tuned threshold = %d, threads = %d\n", tuning.threshold, tuning.threads);
+    } else {
+        strassenLoadTuning(options->tuningFile, type, &tuning);
+    }
+
+    int threshold = (options->threshold >= 0) ? (1 << options->threshold) : tuning.threshold;
+    int threads = (options->threads > 0) ? options->threads : tuning.threads;
+    omp_set_num_threads(threads);
+
+    StrassenParams params;
+    params.threshold = threshold;
+    params.taskDepth = options->taskDepth;
+    params.maxDepth = options->maxDepth;
+
+    // Integer products are exact but wrap silently once a sum of products
+    // leaves the range of T
+    if (std::numeric_limits<T>::is_integer && (double)k * 999 * 999 > (double)std::numeric_limits<T>::max()) {
+        printf("Warning: sums of products may overflow %s and wrap around\n", type);
+    }
+
+    Matrix<T> A = matrixAllocate<T>(m, k);
+    Matrix<T> B = matrixAllocate<T>(k, n);
+    Matrix<T> C = matrixAllocate<T>(m, n);
+
+    matrixRand(A, MATRIX_SEED_A);
+    matrixRand(B, MATRIX_SEED_B);
+
+    // All Strassen temporaries come from this one block
+    T* work = alignedAllocate<T>(strassenWorkspace<T>(&params, m, n, k, 0, 0));
 
     clock_gettime(CLOCK_REALTIME, &start);
-    omp_set_num_threads(8);
     #pragma omp parallel
     {
         #pragma omp single
         {
-            matrixStrassen(threshold, n, A, B, C);
+            matrixStrassen(&params, A, B, C, work);
         }
     }
     clock_gettime(CLOCK_REALTIME, &stop);
     total_time = (stop.tv_sec - start.tv_sec) + 0.000000001 * (stop.tv_nsec - start.tv_nsec);
 
-    clock_gettime(CLOCK_REALTIME, &start_standard);
-    matrixStandardMul(n, A, B, Cseq);
-    clock_gettime(CLOCK_REALTIME, &stop_standard);
-    total_time_standard = (stop_standard.tv_sec - start_standard.tv_sec) + 0.000000001 * (stop_standard.tv_nsec - start_standard.tv_nsec);
+    // Standard multiply: the standard_time baseline, and the reference
+    // product of the full check
+    int standard = options->standard || (options->check == CHECK_FULL);
+    Matrix<T> Cseq = {};
+    if (standard) {
+        Cseq = matrixAllocate<T>(m, n);
+        clock_gettime(CLOCK_REALTIME, &start_standard);
+        matrixStandardMul(A, B, Cseq);
+        clock_gettime(CLOCK_REALTIME, &stop_standard);
+        total_time_standard = (stop_standard.tv_sec - start_standard.tv_sec) + 0.000000001 * (stop_standard.tv_nsec - start_standard.tv_nsec);
+    }
+
+    // Integer results must match exactly; floating-point ones to within the
+    // tolerance, in relative norm
+    double tolerance = options->tolerance >= 0 ? options->tolerance : sqrt((double)std::numeric_limits<T>::epsilon());
+    double error = 0;
+    int correct = 1;
+    clock_gettime(CLOCK_REALTIME, &start_check);
+    if (options->check == CHECK_FULL) {
+        error = matrixRelativeError(C, Cseq);
+        correct = std::numeric_limits<T>::is_integer ? matrixCompare(C, Cseq) : (error <= tolerance);
+    } else if (options->check == CHECK_FAST) {
+        error = matrixFreivalds(A, B, C, FREIVALDS_SEED);
+        correct = std::numeric_limits<T>::is_integer ? (error == 0) : (error <= tolerance);
+    }
+    clock_gettime(CLOCK_REALTIME, &stop_check);
+    total_time_check = (stop_check.tv_sec - start_check.tv_sec) + 0.000000001 * (stop_check.tv_nsec - start_check.tv_nsec);
 
-    if (matrixCompare(n, C, Cseq)) {
-        printf("Correct!!!\n");
-        printf("Matrix Size = %d * %d, Threshold = %d, time (sec) = %8.4f, standard_time = %8.4f\n",
-            n, n, threshold, total_time, total_time_standard);
+    if (correct) {
+        if (options->check != CHECK_NONE) printf("Correct!!!\n");
+        printf("Matrix Size = %d * %d times %d * %d, Type = %s, Threshold = %d, Threads = %d, error = %g, time (sec) = %8.4f",
+            m, k, k, n, type, threshold, threads, error, total_time);
+        if (standard) printf(", standard_time = %8.4f", total_time_standard);
+        printf(", check (%s) time = %8.4f\n", check_names[options->check], total_time_check);
     } else {
-        printf("We have a problem!\n");
+        printf("We have a problem! Relative error = %g\n", error);
+    }
+
+    matrixFree(A);
+    matrixFree(B);
+    matrixFree(C);
+    if (standard) matrixFree(Cseq);
+    free(work);
+
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    options.m = options.n = options.k = 0;
+    options.threshold = -1;
+    options.taskDepth = STRASSEN_TASK_DEPTH;
+    options.maxDepth = -1;
+    options.threads = 0;
+    options.autotune = 0;
+    options.tuningFile = STRASSEN_TUNING_FILE;
+    options.check = CHECK_FAST;
+    options.standard = 0;
+    options.tolerance = -1;
+    const char* check_names[] = {"none", "fast", "full"};
+    const char* type = "int32";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:n:k:af:p:t:d:e:c:s")) != -1) {
+        switch (opt) {
+            case 'm':
+                options.m = atoi(optarg);
+                break;
+            case 'n':
+                options.n = atoi(optarg);
+                break;
+            case 'k':
+                options.k = atoi(optarg);
+                break;
+            case 'a':
+                options.autotune = 1;
+                break;
+            case 'f':
+                options.tuningFile = optarg;
+                break;
+            case 'p':
+                options.threads = atoi(optarg);
+                break;
+            case 't':
+                type = optarg;
+                break;
+            case 'd':
+                options.maxDepth = atoi(optarg);
+                break;
+            case 'e':
+                options.tolerance = atof(optarg);
+                break;
+            case 'c':
+                for (options.check = CHECK_FULL; options.check >= 0; options.check--) {
+                    if (strcmp(optarg, check_names[options.check]) == 0) break;
+                }
+                if (options.check < 0) {
+                    printf("Unknown verification mode: %s. Use one of: none|fast|full\n", optarg);
+                    exit(0);
+                }
+                break;
+            case 's':
+                options.standard = 1;
+                break;
+            default:
+                exit(0);
+        }
+    }
+    if (argc - optind < 1 || argc - optind > 3) {
+        printf("Need one to three integers as input \n");
+        printf("Use: <executable_name> [-t int32|int64|float|double] [-m rows_of_A] [-k cols_of_A] [-n cols_of_B] [-d max_depth] [-c none|fast|full] [-s] [-e tolerance] [-a] [-f tuning_file] [-p threads] <log_2(matrix_size)> [log_2(threshold) [task_depth]]\n");
+        printf("Without log_2(threshold), the threshold and number of threads are loaded from the tuning file; -a writes it\n");
+        printf("-s times the standard multiply (standard_time) also when it is not needed for the check (-c full)\n");
+        exit(0);
     }
 
-    matrixFree(A, n);
-    matrixFree(B, n);
-    matrixFree(C, n);
-    matrixFree(Cseq, n);
+    int size = (1 << atoi(argv[optind]));
+    if (options.m <= 0) options.m = size;
+    if (options.n <= 0) options.n = size;
+    if (options.k <= 0) options.k = size;
+    if (argc - optind >= 2) options.threshold = atoi(argv[optind + 1]);
+    if (argc - optind == 3) options.taskDepth = atoi(argv[optind + 2]);
 
+    if (strcmp(type, "int32") == 0) return run<int32_t>(&options);
+    if (strcmp(type, "int64") == 0) return run<int64_t>(&options);
+    if (strcmp(type, "float") == 0) return run<float>(&options);
+    if (strcmp(type, "double") == 0) return run<double>(&options);
+    printf("Unknown element type: %s. Use one of: int32|int64|float|double\n", type);
     return 0;
 }
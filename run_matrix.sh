@@ -0,0 +1,64 @@
+#!/bin/bash
+
+# Benchmark matrix: runs every sorter on every input distribution in
+# common/list_init.h and flags runs that fail the correctness check or take
+# much longer than the same sorter on uniform input (quadratic scans, skewed
+# partitions, ...).
+#
+# Build the sorters first, e.g.
+#	gcc -O3 -o HW2/sort_list.exe HW2/sort_list.c -lpthread -lm
+#	gcc -O3 -fopenmp -o HW3/sort_list_openmp.exe HW3/sort_list_openmp_new.c -lm
+#	mpicxx -O3 -fopenmp -o HW4/qsort_hypercube.exe HW4/qsort_hypercube.cpp
+#
+# Usage (from the repository root): ./run_matrix.sh [k] [q] [np]
+#	k	- log_2(list size) for HW2/HW3; HW4 uses 2^k/np elements per process
+#	q	- log_2(num_threads) for HW2/HW3
+#	np	- number of MPI processes for HW4 (power of 2 for hypercube
+#		  quicksort; sample sort runs on any number)
+
+k=${1:-20}
+q=${2:-4}
+np=${3:-4}
+
+# A run slower than SLOWDOWN x the uniform run of the same sorter is flagged
+SLOWDOWN=4
+
+distributions="uniform zipf few_unique all_equal sorted reverse organ_pipe sawtooth staggered"
+
+# Extract the sort time from a line of sorter output
+sort_time() {
+    sed -n -e 's/.*time (sec) = *\([0-9.]*\).*/\1/p' \
+	   -e 's/.*hypercube quicksort time = *\([0-9.]*\).*/\1/p' \
+	   -e 's/.*sample sort time = *\([0-9.]*\).*/\1/p' | head -1
+}
+
+run_sorter() {
+    name=$1; shift
+    uniform_time=""
+    for d in $distributions; do
+	output=$("$@" $d 2>&1)
+	t=$(echo "$output" | sort_time)
+	status="ok"
+	if echo "$output" | grep -q -e "problem" -e "Error encountered"; then
+	    status="WRONG RESULT"
+	elif [ -z "$t" ]; then
+	    status="FAILED"
+	elif [ -z "$uniform_time" ]; then
+	    uniform_time=$t
+	elif awk -v t=$t -v u=$uniform_time -v s=$SLOWDOWN 'BEGIN { exit !(t > s*u) }'; then
+	    status="SLOW (> ${SLOWDOWN}x uniform)"
+	fi
+	printf "%-16s %-12s %10s  %s\n" "$name" "$d" "${t:--}" "$status"
+    done
+}
+
+printf "%-16s %-12s %10s  %s\n" "sorter" "distribution" "time (sec)" "status"
+
+[ -x HW2/sort_list.exe ] && \
+    run_sorter "HW2 pthreads" sh -c 'HW2/sort_list.exe -d $0 '"$k $q"
+[ -x HW3/sort_list_openmp.exe ] && \
+    run_sorter "HW3 openmp" sh -c 'HW3/sort_list_openmp.exe -d $0 '"$k $q"
+[ -x HW4/qsort_hypercube.exe ] && \
+    run_sorter "HW4 hypercube" sh -c 'mpirun -np '"$np"' HW4/qsort_hypercube.exe '"$(( (1 << k) / np ))"' $0'
+[ -x HW4/qsort_hypercube.exe ] && \
+    run_sorter "HW4 sample sort" sh -c 'mpirun -np '"$np"' HW4/qsort_hypercube.exe -a sample '"$(( (1 << k) / np ))"' $0'